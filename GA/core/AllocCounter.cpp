@@ -0,0 +1,80 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include "AllocCounter.hpp"
+#include "ParallelUtils.hpp"
+
+#ifdef _DO_TIMING
+
+// Each thread counts into its own cache line so that
+// counting does not add the contention we try to measure
+#define ALLOC_COUNTER_SLOTS 256
+
+namespace elfin
+{
+
+struct alignas(64) AllocCounterSlot
+{
+	std::atomic<ulong> count;
+};
+
+static AllocCounterSlot allocCounterSlots[ALLOC_COUNTER_SLOTS];
+
+static inline void *
+countedAlloc(std::size_t size)
+{
+	const int slot = omp_get_thread_num() % ALLOC_COUNTER_SLOTS;
+	allocCounterSlots[slot].count.fetch_add(1, std::memory_order_relaxed);
+
+	void * ptr = std::malloc(size ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+ulong getAllocCount()
+{
+	ulong total = 0;
+	for (int i = 0; i < ALLOC_COUNTER_SLOTS; i++)
+		total += allocCounterSlots[i].count.load(std::memory_order_relaxed);
+
+	return total;
+}
+
+} // namespace elfin
+
+void * operator new(std::size_t size)
+{
+	return elfin::countedAlloc(size);
+}
+
+void * operator new[](std::size_t size)
+{
+	return elfin::countedAlloc(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+#else //ifdef _DO_TIMING
+
+namespace elfin
+{
+
+ulong getAllocCount()
+{
+	return 0;
+}
+
+} // namespace elfin
+
+#endif //ifdef _DO_TIMING
@@ -0,0 +1,15 @@
+#ifndef _ALLOCCOUNTER_HPP_
+#define _ALLOCCOUNTER_HPP_
+
+#include "../data/PrimitiveShorthands.hpp"
+
+namespace elfin
+{
+
+// Total number of operator new calls made by all threads.
+// Only counted when built with _DO_TIMING; 0 otherwise.
+ulong getAllocCount();
+
+} // namespace elfin
+
+#endif /* include guard */
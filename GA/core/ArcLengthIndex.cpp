@@ -0,0 +1,362 @@
+#include "ArcLengthIndex.hpp"
+
+#include <algorithm>
+
+#include "util.h"
+#include "BenchUtils.hpp"
+
+namespace elfin
+{
+
+ArcLengthIndex::ArcLengthIndex(const Points3f & pts)
+{
+	build(pts);
+}
+
+void
+ArcLengthIndex::build(const Points3f & pts)
+{
+	const uint n = pts.size();
+	panic_if(n < 1, "ArcLengthIndex::build(): no points\n");
+
+	myPoints.assign(pts.begin(), pts.end());
+	mySegments.resize(n);
+	myProportions.resize(n);
+
+	const Point3f * p = myPoints.data();
+	float * segments = mySegments.data();
+	float * props = myProportions.data();
+
+	myTotalLength = 0.0f;
+	segments[0] = 0.0f;
+	for (int i = 1; i < n; i++)
+	{
+		segments[i] = p[i].distTo(p[i - 1]);
+		myTotalLength += segments[i];
+	}
+
+	props[0] = 0.0f;
+	for (int i = 1; i < n; i++)
+	{
+		segments[i] = segments[i] / myTotalLength;
+		props[i] = props[i - 1] + segments[i];
+	}
+}
+
+void
+ArcLengthIndex::reserve(const uint n)
+{
+	myPoints.reserve(n);
+	mySegments.reserve(n);
+	myProportions.reserve(n);
+}
+
+uint
+ArcLengthIndex::size() const
+{
+	return myPoints.size();
+}
+
+float
+ArcLengthIndex::totalLength() const
+{
+	return myTotalLength;
+}
+
+const Points3f &
+ArcLengthIndex::points() const
+{
+	return myPoints;
+}
+
+const std::vector<float> &
+ArcLengthIndex::proportions() const
+{
+	return myProportions;
+}
+
+Point3f
+ArcLengthIndex::at(const float proportion) const
+{
+	uint seg = 1;
+	return interpolate(proportion, seg);
+}
+
+void
+ArcLengthIndex::resample(
+    const std::vector<float> & proportions,
+    Points3f & out) const
+{
+	const uint N = proportions.size();
+	out.resize(N);
+
+	if (N == 0)
+		return;
+
+	// First points are the same
+	out[0] = myPoints[0];
+
+	// Targets are ascending, so each search can start at
+	// the segment the previous target fell in
+	uint seg = 1;
+	for (int m = 1; m < N; m++)
+		out[m] = interpolate(proportions[m], seg);
+}
+
+void
+ArcLengthIndex::resample(const uint count, Points3f & out) const
+{
+	out.resize(count);
+
+	if (count == 0)
+		return;
+
+	out.at(0) = myPoints.front();
+	uint seg = 1;
+	for (int m = 1; m < count - 1; m++)
+		out.at(m) = interpolate((float) m / (count - 1), seg);
+
+	// Ends are kept exact
+	if (count > 1)
+		out.at(count - 1) = myPoints.back();
+}
+
+/*
+ * Finds the first segment at or after seg whose end
+ * proportion reaches the target and interpolates within it;
+ * this is the segment a joint walk of both polylines would
+ * have emitted it from. seg is left at the segment found.
+ */
+Point3f
+ArcLengthIndex::interpolate(const float proportion, uint & seg) const
+{
+	const float * props = myProportions.data();
+	const uint n = myProportions.size();
+
+	seg = std::lower_bound(props + seg, props + n, proportion) - props;
+
+	// Rounding can leave the last proportion just short of
+	// the target; the target then is the last point
+	if (seg == n)
+	{
+		seg = n - 1;
+		return myPoints[n - 1];
+	}
+
+	const Point3f & base = myPoints[seg - 1];
+	const Point3f & next = myPoints[seg];
+	const float s = (proportion - props[seg - 1]) / mySegments[seg];
+
+	return base + ((next - base) * s);
+}
+
+/*
+ * The joint polyline walk that resample() used before this
+ * index existed; kept to check the index against and to
+ * time it in the benchmark.
+ */
+static void
+walkResample(
+    const Points3f & ref,
+    const Points3f & pts,
+    Points3f & out)
+{
+	const uint N = ref.size();
+
+	float refTotLen = 0.0f;
+	for (int i = 1; i < N; i++)
+		refTotLen += ref.at(i).distTo(ref.at(i - 1));
+
+	float ptsTotLen = 0.0f;
+	for (int i = 1; i < pts.size(); i++)
+		ptsTotLen += pts.at(i).distTo(pts.at(i - 1));
+
+	out.clear();
+	out.push_back(pts.at(0));
+
+	float refProp = 0.0f, ptsProp = 0.0f;
+	int mpi = 1;
+	for (int i = 1; i < pts.size(); i++)
+	{
+		const Point3f & baseFpPoint = pts.at(i - 1);
+		const Point3f & nextFpPoint = pts.at(i);
+		const float baseFpProportion = ptsProp;
+		const float fpSegment = nextFpPoint.distTo(baseFpPoint)
+		                        / ptsTotLen;
+		const Vector3f vec = nextFpPoint - baseFpPoint;
+
+		ptsProp += fpSegment;
+		while (refProp <= ptsProp && mpi < N)
+		{
+			const float mpSegment =
+			    ref.at(mpi).distTo(ref.at(mpi - 1))
+			    / refTotLen;
+
+			if (refProp + mpSegment > ptsProp)
+				break;
+			refProp += mpSegment;
+
+			const float s = (refProp - baseFpProportion)
+			                / fpSegment;
+			out.push_back(baseFpPoint + (vec * s));
+
+			mpi++;
+		}
+	}
+
+	if (out.size() < N)
+		out.push_back(pts.back());
+}
+
+int _testArcLengthIndex()
+{
+	using namespace elfin;
+
+	msg("Testing ArcLengthIndex\n");
+
+	uint failCount = 0;
+
+	// Resampling through the index must reproduce the joint
+	// walk exactly for every length a chromosome can take
+	const std::vector<BenchSpec> specs =
+	    loadBenchSpecs(std::string(BENCH_SPEC_ROOT) + "l20");
+	if (specs.size() == 0)
+	{
+		failCount++;
+		err("No specs to test ArcLengthIndex with\n");
+	}
+
+	uint seed = 0x1337;
+	for (const auto & spec : specs)
+	{
+		const ArcLengthIndex specIndex(spec.coms);
+		const uint n = spec.coms.size();
+
+		for (uint len = std::max(n, 5u) - 4; len <= n + 4; len++)
+		{
+			Points3f mobile;
+			specIndex.resample(len, mobile);
+			mobile = jitterPoints(mobile, 6.0f, seed);
+
+			Points3f walked, indexed;
+			walkResample(spec.coms, mobile, walked);
+			ArcLengthIndex(mobile).resample(specIndex.proportions(), indexed);
+
+			bool same = walked.size() == indexed.size();
+			for (int i = 0; same && i < walked.size(); i++)
+				same = walked.at(i).x == indexed.at(i).x &&
+				       walked.at(i).y == indexed.at(i).y &&
+				       walked.at(i).z == indexed.at(i).z;
+
+			if (!same)
+			{
+				failCount++;
+				err("Index resample of %s (len %u) differs from walk\n",
+				    spec.name.c_str(), len);
+			}
+		}
+	}
+
+	// Coarse versions keep the ends and are evenly spaced
+	{
+		Points3f line;
+		for (int i = 0; i < 5; i++)
+			line.push_back(Point3f(0, 0, i * i));
+
+		Points3f coarse;
+		ArcLengthIndex(line).resample(3, coarse);
+		if (coarse.size() != 3 ||
+		        !coarse.at(0).approximates(line.front()) ||
+		        !coarse.at(1).approximates(Point3f(0, 0, 8)) ||
+		        !coarse.at(2).approximates(line.back()))
+		{
+			failCount++;
+			err("Coarse resample of a line is wrong\n");
+		}
+
+		if (!ArcLengthIndex(line).at(1.5f).approximates(line.back()))
+		{
+			failCount++;
+			err("Proportion past the end should give the last point\n");
+		}
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+int _benchArcLengthIndex()
+{
+	msg("Benchmarking resample: joint walk vs ArcLengthIndex\n");
+
+	// Long specs and freehand letter shapes are where the
+	// walk's cost shows
+	const char * dirs[] = { "l30", "fun" };
+	const uint lenDev = 3;
+	const int reps = 2000;
+
+	int failCount = 0;
+	for (const char * dir : dirs)
+	{
+		const std::vector<BenchSpec> specs = loadBenchSpecs(
+		        std::string(BENCH_SPEC_ROOT) + dir);
+		if (specs.size() == 0)
+			continue;
+
+		double walkTime = 0.0, indexTime = 0.0;
+		ulong resampled = 0;
+		uint seed = 0x600d1337;
+
+		for (const auto & spec : specs)
+		{
+			const uint n = spec.coms.size();
+			const ArcLengthIndex specIndex(spec.coms);
+
+			// Mobile chains a few modules off the spec length
+			std::vector<Points3f> mobiles;
+			for (uint len = std::max(n, lenDev + 2) - lenDev; len <= n + lenDev; len++)
+			{
+				Points3f mobile;
+				specIndex.resample(len, mobile);
+				mobiles.push_back(jitterPoints(mobile, 8.0f, seed));
+			}
+
+			Points3f out;
+			out.reserve(n);
+			ArcLengthIndex mobileIndex;
+
+			double t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				for (const auto & mobile : mobiles)
+					walkResample(spec.coms, mobile, out);
+			walkTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				for (const auto & mobile : mobiles)
+				{
+					mobileIndex.build(mobile);
+					mobileIndex.resample(specIndex.proportions(), out);
+				}
+			indexTime += get_timestamp_us() - t0;
+
+			resampled += (ulong) reps * mobiles.size();
+		}
+
+		msg("%s (%lu specs): walk %.1fns/shape, index %.1fns/shape (%.2fx)\n",
+		    dir,
+		    specs.size(),
+		    walkTime * 1e3 / resampled,
+		    indexTime * 1e3 / resampled,
+		    walkTime / indexTime);
+	}
+
+	return failCount;
+}
+
+} // namespace elfin
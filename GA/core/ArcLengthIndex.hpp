@@ -0,0 +1,69 @@
+#ifndef _ARCLENGTHINDEX_HPP_
+#define _ARCLENGTHINDEX_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+
+namespace elfin
+{
+
+/*
+ * Cumulative arc length of a polyline, built once with one
+ * square root per segment. Any point along the polyline can
+ * then be found by binary search over the prefix sums, so a
+ * resample to N points costs O(N log n) instead of a joint
+ * walk that re-measures both shapes.
+ *
+ * Proportions are accumulated in float in the same order as
+ * the old resample() walk, so resampled shapes (and hence
+ * scores) are unchanged.
+ */
+class ArcLengthIndex
+{
+public:
+	ArcLengthIndex() {};
+	ArcLengthIndex(const Points3f & pts);
+	virtual ~ArcLengthIndex() {};
+
+	// (Re)index pts; reuses capacity so rebuilding for a
+	// shape no longer than before does not allocate
+	void build(const Points3f & pts);
+	void reserve(const uint n);
+
+	uint size() const;
+	float totalLength() const;
+	const Points3f & points() const;
+
+	// Entry i is the fraction of total length covered at
+	// point i; entry 0 is 0
+	const std::vector<float> & proportions() const;
+
+	// Point at a fraction of the total length; fractions
+	// beyond the last proportion give the last point
+	Point3f at(const float proportion) const;
+
+	// One output point per entry of proportions. The first
+	// output point is always the first indexed point
+	void resample(const std::vector<float> & proportions,
+	              Points3f & out) const;
+
+	// count points evenly spaced by arc length; used to make
+	// coarse versions of a spec
+	void resample(const uint count, Points3f & out) const;
+
+private:
+	Points3f myPoints;
+	std::vector<float> mySegments; // Fraction of total length per segment
+	std::vector<float> myProportions;
+	float myTotalLength = 0.0f;
+
+	Point3f interpolate(const float proportion, uint & seg) const;
+};
+
+int _testArcLengthIndex();
+int _benchArcLengthIndex();
+
+} // namespace elfin
+
+#endif /* include guard */
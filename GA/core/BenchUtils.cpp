@@ -0,0 +1,95 @@
+#include "BenchUtils.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+
+#include "util.h"
+#include "../input/JSONParser.hpp"
+#include "../input/CSVParser.hpp"
+#include "../data/Chromosome.hpp"
+
+namespace elfin
+{
+
+static bool
+hasExtension(const std::string & name, const std::string & ext)
+{
+	return name.size() > ext.size() &&
+	       name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+std::vector<BenchSpec>
+loadBenchSpecs(const std::string & dir)
+{
+	std::vector<BenchSpec> specs;
+
+	DIR * dp = opendir(dir.c_str());
+	if (dp == NULL)
+	{
+		wrn("Could not open benchmark directory \"%s\"\n", dir.c_str());
+		return specs;
+	}
+
+	std::vector<std::string> names;
+	for (struct dirent * ep = readdir(dp); ep != NULL; ep = readdir(dp))
+	{
+		const std::string name(ep->d_name);
+		if (hasExtension(name, ".json") || hasExtension(name, ".csv"))
+			names.push_back(name);
+	}
+	closedir(dp);
+
+	std::sort(names.begin(), names.end());
+	for (const auto & name : names)
+	{
+		BenchSpec bs;
+		bs.name = name;
+		const std::string path = dir + "/" + name;
+		bs.coms = hasExtension(name, ".json") ?
+		          JSONParser().parseSpec(path) :
+		          CSVParser().parseSpec(path);
+		specs.push_back(bs);
+	}
+
+	return specs;
+}
+
+Points3f
+jitterPoints(const Points3f & pts,
+             const float amplitude,
+             uint & seed)
+{
+	Points3f out = pts;
+
+	for (auto & p : out)
+	{
+		p.x += amplitude * (2.0f * rand_r(&seed) / RAND_MAX - 1.0f);
+		p.y += amplitude * (2.0f * rand_r(&seed) / RAND_MAX - 1.0f);
+		p.z += amplitude * (2.0f * rand_r(&seed) / RAND_MAX - 1.0f);
+	}
+
+	return out;
+}
+
+const BenchDB &
+setupBenchChromosome(const uint maxLen)
+{
+	static BenchDB db;
+	static bool parsed = false;
+
+	if (!parsed)
+	{
+		JSONParser().parseDB(BENCH_XDB_PATH,
+		                     db.nameIdMap,
+		                     db.idNameMap,
+		                     db.relaMat,
+		                     db.radiiList);
+		Chromosome::setup(0, maxLen, db.relaMat, db.radiiList);
+		parsed = true;
+	}
+
+	return db;
+}
+
+} // namespace elfin
@@ -0,0 +1,56 @@
+#ifndef _BENCHUTILS_HPP_
+#define _BENCHUTILS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+
+namespace elfin
+{
+
+// Benchmark spec directories, relative to bin/ like the
+// xDB path used by the unit tests
+#define FOREACH_BENCH_SPEC_DIR(v) \
+		v(l10) \
+		v(l20) \
+		v(l30)
+
+#define BENCH_SPEC_ROOT "../../bm/"
+#define BENCH_XDB_PATH "../../res/xDB.json"
+
+struct BenchSpec
+{
+	std::string name;
+	Points3f coms;
+};
+
+// Parse every .json or .csv spec in a benchmark directory, sorted
+// by file name; returns an empty list if the directory
+// cannot be read
+std::vector<BenchSpec> loadBenchSpecs(const std::string & dir);
+
+// Deterministically jitter every point by up to +-amplitude
+// on each axis
+Points3f jitterPoints(const Points3f & pts,
+                      const float amplitude,
+                      uint & seed);
+
+// Database parsed from BENCH_XDB_PATH, for benchmarks that
+// grow chains
+struct BenchDB
+{
+	RelaMat relaMat;
+	NameIdMap nameIdMap;
+	IdNameMap idNameMap;
+	RadiiList radiiList;
+};
+
+// Parses the database once and sets up Chromosome with it;
+// later calls return the same database. Benchmarks run on
+// their own, so nothing else has set up Chromosome
+const BenchDB & setupBenchChromosome(const uint maxLen);
+
+} // namespace elfin
+
+#endif /* include guard */
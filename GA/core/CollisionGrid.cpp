@@ -0,0 +1,672 @@
+#include "CollisionGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "util.h"
+#include "MathUtils.hpp"
+#include "BenchUtils.hpp"
+#include "../data/Chromosome.hpp"
+#include "../data/PairRelationship.hpp"
+#include "../input/JSONParser.hpp"
+
+namespace elfin
+{
+
+#if COLLISION_KERNEL_LANES > 32
+#error "collidesSoA() keeps one bit per lane in a uint"
+#endif
+
+float CollisionGrid::myCellSize = 0.0f;
+CollisionNodes CollisionGrid::myNodes;
+CollisionGrid::Query CollisionGrid::myQuery = NULL;
+std::vector<float> CollisionGrid::myNodeRadii;
+
+CollisionNodes::CollisionNodes(const RadiiList & radiiList) :
+	radii(radiiList)
+{
+	for (const auto & r : radiiList)
+	{
+		lo.push_back(std::min(std::min(r.avgAll, r.maxCA), r.maxHeavy));
+		hi.push_back(std::max(std::max(r.avgAll, r.maxCA), r.maxHeavy));
+	}
+}
+
+float
+CollisionNodes::maxRadius() const
+{
+	float maxR = 0.0f;
+	for (const float r : hi)
+		maxR = std::max(maxR, r);
+	return maxR;
+}
+
+void
+CollisionSpheres::set(
+    const uint geneIndex,
+    const Gene & gene,
+    const CollisionNodes & nodes)
+{
+	if (geneIndex >= xs.size())
+	{
+		xs.resize(geneIndex + 1);
+		ys.resize(geneIndex + 1);
+		zs.resize(geneIndex + 1);
+		lo.resize(geneIndex + 1);
+		hi.resize(geneIndex + 1);
+		ids.resize(geneIndex + 1);
+	}
+
+	const Point3f & com = gene.com();
+	const uint id = gene.nodeId();
+	xs[geneIndex] = com.x;
+	ys[geneIndex] = com.y;
+	zs[geneIndex] = com.z;
+	lo[geneIndex] = nodes.lo[id];
+	hi[geneIndex] = nodes.hi[id];
+	ids[geneIndex] = id;
+}
+
+static inline float
+squaredDist(const CollisionSpheres & spheres, const uint i, const Point3f & pt)
+{
+	const float dx = spheres.xs[i] - pt.x;
+	const float dy = spheres.ys[i] - pt.y;
+	const float dz = spheres.zs[i] - pt.z;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Second phase: the radii of measure M
+template <CollisionMeasure M>
+static inline bool
+exactCollides(
+    const CollisionNodes & nodes,
+    const CollisionSpheres & spheres,
+    const uint i,
+    const uint newId,
+    const Point3f & pt)
+{
+	const float reach = measureRadius<M>(nodes.radii[spheres.ids[i]]) +
+	                    measureRadius<M>(nodes.radii[newId]);
+	return squaredDist(spheres, i, pt) < reach * reach;
+}
+
+// Both phases for a single sphere
+template <CollisionMeasure M>
+static inline bool
+sphereCollides(
+    const CollisionNodes & nodes,
+    const CollisionSpheres & spheres,
+    const uint i,
+    const uint newId,
+    const Point3f & pt)
+{
+	const float d2 = squaredDist(spheres, i, pt);
+
+	const float lo = spheres.lo[i] + nodes.lo[newId];
+	if (d2 < lo * lo)
+		return true;
+
+	const float hi = spheres.hi[i] + nodes.hi[newId];
+	if (d2 >= hi * hi)
+		return false;
+
+	return exactCollides<M>(nodes, spheres, i, newId, pt);
+}
+
+template <CollisionMeasure M>
+bool
+collidesSoA(
+    const CollisionNodes & nodes,
+    const CollisionSpheres & spheres,
+    const uint begin,
+    const uint end,
+    const uint newId,
+    const Point3f & pt)
+{
+	const uint L = COLLISION_KERNEL_LANES;
+	const float * xs = spheres.xs.data();
+	const float * ys = spheres.ys.data();
+	const float * zs = spheres.zs.data();
+	const float * los = spheres.lo.data();
+	const float * his = spheres.hi.data();
+	const float px = pt.x, py = pt.y, pz = pt.z;
+	const float newLo = nodes.lo[newId];
+	const float newHi = nodes.hi[newId];
+
+	uint i = begin;
+	for (; i + L <= end; i += L)
+	{
+		int hit = 0;
+		uint band = 0;
+		#pragma omp simd reduction(|:hit, band)
+		for (int l = 0; l < L; l++)
+		{
+			const float dx = xs[i + l] - px;
+			const float dy = ys[i + l] - py;
+			const float dz = zs[i + l] - pz;
+			const float d2 = dx * dx + dy * dy + dz * dz;
+			const float lo = los[i + l] + newLo;
+			const float hi = his[i + l] + newHi;
+			hit |= d2 < lo * lo;
+			band |= (uint) (d2 < hi * hi) << l;
+		}
+
+		if (hit)
+			return true;
+
+		// Lanes the bounds could not decide
+		for (; band; band &= band - 1)
+			if (exactCollides<M>(nodes, spheres, i + __builtin_ctz(band), newId, pt))
+				return true;
+	}
+
+	for (; i < end; i++)
+		if (sphereCollides<M>(nodes, spheres, i, newId, pt))
+			return true;
+
+	return false;
+}
+
+#define INSTANTIATE_COLLIDES_SOA(measure) \
+	template bool collidesSoA<measure>(const CollisionNodes &, \
+	                                   const CollisionSpheres &, \
+	                                   const uint, \
+	                                   const uint, \
+	                                   const uint, \
+	                                   const Point3f &);
+FOREACH_COLLISION_MEASURE(INSTANTIATE_COLLIDES_SOA)
+#undef INSTANTIATE_COLLIDES_SOA
+
+CollisionGrid::CollisionGrid() :
+	myHeads(COLLISION_GRID_BUCKETS, -1)
+{}
+
+void
+CollisionGrid::reset()
+{
+	// Only buckets that were used need clearing
+	for (const auto & e : myEntries)
+		myHeads[e.bucket] = -1;
+	myEntries.clear();
+}
+
+void
+CollisionGrid::build(const Genes & genes)
+{
+	reset();
+	for (int i = 0; i < genes.size(); i++)
+		insert(i, genes.at(i));
+}
+
+void
+CollisionGrid::insert(const uint geneIndex, const Gene & gene)
+{
+	panic_if(myQuery == NULL, "CollisionGrid::setup() not called!\n");
+
+	mySpheres.set(geneIndex, gene, myNodes);
+
+	int cell[3];
+	toCell(gene.com(), cell);
+
+	Entry e;
+	e.geneIndex = geneIndex;
+	e.bucket = hashCell(cell[0], cell[1], cell[2]);
+	e.next = myHeads[e.bucket];
+
+	myHeads[e.bucket] = myEntries.size();
+	myEntries.push_back(e);
+}
+
+uint
+CollisionGrid::size() const
+{
+	return myEntries.size();
+}
+
+bool
+CollisionGrid::collides(
+    const uint newId,
+    const Point3f & newCOM,
+    const int beginIndex,
+    const int endIndex) const
+{
+	if (beginIndex >= endIndex)
+		return false;
+
+	return (this->*myQuery)(newId, newCOM, beginIndex, endIndex);
+}
+
+void
+CollisionGrid::setup(
+    const RadiiList & radiiList,
+    const CollisionMeasure measure)
+{
+	myNodes = CollisionNodes(radiiList);
+	myCellSize = 2 * myNodes.maxRadius() + COLLISION_GRID_SLACK;
+	myNodeRadii.clear();
+
+	switch (measure)
+	{
+#define SELECT_QUERY(m) \
+	case m: \
+		myQuery = &CollisionGrid::query<m>; \
+		for (const auto & r : radiiList) \
+			myNodeRadii.push_back(measureRadius<m>(r)); \
+		break;
+		FOREACH_COLLISION_MEASURE(SELECT_QUERY)
+#undef SELECT_QUERY
+	default:
+		die("Unknown collision measure %d\n", measure);
+	}
+}
+
+const std::vector<float> &
+CollisionGrid::nodeRadii()
+{
+	return myNodeRadii;
+}
+
+// Private methods
+
+template <CollisionMeasure M>
+bool
+CollisionGrid::query(
+    const uint newId,
+    const Point3f & newCOM,
+    const int beginIndex,
+    const int endIndex) const
+{
+	// Visiting 27 cells costs more than a pass over a short
+	// range
+	if (endIndex - beginIndex <= COLLISION_GRID_MIN_CELL_SCAN)
+		return collidesSoA<M>(myNodes, mySpheres, beginIndex, endIndex, newId, newCOM);
+
+	int cell[3];
+	toCell(newCOM, cell);
+
+	const Entry * entries = myEntries.data();
+	for (int dx = -1; dx <= 1; dx++)
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				const uint bucket = hashCell(cell[0] + dx,
+				                             cell[1] + dy,
+				                             cell[2] + dz);
+
+				for (int ei = myHeads[bucket]; ei != -1; ei = entries[ei].next)
+				{
+					const int gi = entries[ei].geneIndex;
+					if (gi < beginIndex || gi >= endIndex)
+						continue;
+
+					if (sphereCollides<M>(myNodes, mySpheres, gi, newId, newCOM))
+						return true;
+				}
+			}
+
+	return false;
+}
+
+void
+CollisionGrid::toCell(const Point3f & pt, int cell[3])
+{
+	cell[0] = (int) floor(pt.x / myCellSize);
+	cell[1] = (int) floor(pt.y / myCellSize);
+	cell[2] = (int) floor(pt.z / myCellSize);
+}
+
+uint
+CollisionGrid::hashCell(const int x, const int y, const int z)
+{
+	const uint h = ((uint) x * 73856093u) ^
+	               ((uint) y * 19349663u) ^
+	               ((uint) z * 83492791u);
+	return h & (COLLISION_GRID_BUCKETS - 1);
+}
+
+CollisionGrid &
+getCollisionGrid()
+{
+	static thread_local CollisionGrid grid;
+	return grid;
+}
+
+// Linear scan under a measure known only at run time
+static bool
+linearCollides(
+    const CollisionMeasure measure,
+    const uint newId,
+    const Point3f & pt,
+    ConstGeneIterator beginGene,
+    ConstGeneIterator endGene,
+    const RadiiList & radiiList)
+{
+	switch (measure)
+	{
+	case AvgAll:
+		return collides<AvgAll>(newId, pt, beginGene, endGene, radiiList);
+	case MaxCA:
+		return collides<MaxCA>(newId, pt, beginGene, endGene, radiiList);
+	default:
+		return collides<MaxHeavy>(newId, pt, beginGene, endGene, radiiList);
+	}
+}
+
+int _testCollisionGrid()
+{
+	using namespace elfin;
+
+	msg("Testing CollisionGrid\n");
+
+	uint failCount = 0;
+
+	RelaMat relaMat;
+	NameIdMap nameIdMap;
+	IdNameMap idNameMap;
+	RadiiList radiiList;
+	JSONParser().parseDB("../../res/xDB.json", nameIdMap, idNameMap, relaMat, radiiList);
+
+	const CollisionMeasure measures[] = { AvgAll, MaxCA, MaxHeavy };
+	const uint dim = radiiList.size();
+
+	// Probes on which measures disagree, i.e. that land in
+	// the band between the bounds
+	uint bandProbes = 0;
+
+	for (const CollisionMeasure measure : measures)
+	{
+		CollisionGrid::setup(radiiList, measure);
+
+		uint seed = 0x1337;
+		auto randf = [&seed](const float amplitude) {
+			return amplitude * (2.0f * rand_r(&seed) / RAND_MAX - 1.0f);
+		};
+
+		// A random walk stands in for a chain; probes around
+		// its growing end must get the same answer from the
+		// grid as from a linear scan
+		CollisionGrid grid;
+		Genes genes;
+		uint mismatches = 0, hits = 0, probes = 0;
+
+		auto probe = [&](const Point3f & around) {
+			for (int p = 0; p < 40; p++)
+			{
+				const uint id = rand_r(&seed) % dim;
+				const Point3f pt = around + Point3f(randf(60.0f), randf(60.0f), randf(60.0f));
+				const uint drop = std::min((uint) (rand_r(&seed) % 3), (uint) genes.size());
+				const uint end = genes.size() - drop;
+
+				const bool linear = linearCollides(measure, id, pt,
+				                                   genes.begin(), genes.begin() + end, radiiList);
+				if (grid.collides(id, pt, 0, end) != linear)
+					mismatches++;
+				if (collides<AvgAll>(id, pt, genes.begin(), genes.begin() + end, radiiList) !=
+				        collides<MaxHeavy>(id, pt, genes.begin(), genes.begin() + end, radiiList))
+					bandProbes++;
+				hits += linear;
+				probes++;
+			}
+		};
+
+		Point3f tip(0, 0, 0);
+		for (int step = 0; step < 120; step++)
+		{
+			probe(tip);
+
+			genes.emplace_back(rand_r(&seed) % dim, tip);
+			grid.insert(genes.size() - 1, genes.back());
+
+			tip += Point3f(randf(38.0f), randf(38.0f), randf(38.0f));
+		}
+
+		CollisionGrid rebuilt;
+		rebuilt.build(genes);
+		for (int p = 0; p < 400; p++)
+		{
+			const uint id = rand_r(&seed) % dim;
+			const Point3f pt = genes.at(rand_r(&seed) % genes.size()).com() +
+			                   Point3f(randf(60.0f), randf(60.0f), randf(60.0f));
+			if (rebuilt.collides(id, pt, 0, genes.size()) !=
+			        linearCollides(measure, id, pt, genes.begin(), genes.end(), radiiList))
+				mismatches++;
+			probes++;
+		}
+
+		if (mismatches > 0)
+		{
+			failCount++;
+			err("Grid disagrees with linear scan on %u of %u probes under %s\n",
+			    mismatches, probes, CollisionMeasureString[measure]);
+		}
+
+		if (hits == 0 || hits == probes)
+		{
+			failCount++;
+			err("Probes should include both colliding and free points (%u/%u) under %s\n",
+			    hits, probes, CollisionMeasureString[measure]);
+		}
+	}
+
+	if (bandProbes == 0)
+	{
+		failCount++;
+		err("No probe told the collision measures apart\n");
+	}
+
+	// Leave the default measure for later tests
+	CollisionGrid::setup(radiiList);
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+int _benchCollisionGrid()
+{
+	msg("Benchmarking growth collision checks: linear scan vs CollisionGrid\n");
+
+	const uint lens[] = { 30, 60, 100 };
+	const uint chainsPerLen = 200;
+	const int reps = 20;
+
+	const BenchDB & db = setupBenchChromosome(100);
+
+	int failCount = 0;
+	for (const uint len : lens)
+	{
+		std::vector<Genes> chains;
+		ulong genes = 0;
+		for (int c = 0; c < chainsPerLen; c++)
+		{
+			// Retry short chains like randomise() does
+			Genes chain;
+			do
+			{
+				chain = Chromosome::genRandomGenes(len);
+			}
+			while (chain.size() < len);
+
+			chains.push_back(chain);
+			genes += chain.size();
+		}
+
+		// Replay each chain's growth scan: at every step,
+		// every neighbour of the growth tip is checked
+		// against the genes before it, at the next gene's
+		// position
+		double linearTime = 0.0, gridTime = 0.0;
+		ulong queries = 0, mismatches = 0;
+		CollisionGrid grid;
+
+		for (const auto & chain : chains)
+		{
+			grid.build(chain);
+
+			// (candidate id, step) pairs
+			std::vector<std::tuple<uint, uint>> steps;
+			for (int i = 2; i < chain.size(); i++)
+			{
+				const auto & row = db.relaMat.at(chain.at(i - 1).nodeId());
+				for (int j = 0; j < row.size(); j++)
+					if (row.at(j))
+						steps.emplace_back(j, i);
+			}
+
+			std::vector<bool> linearHits(steps.size()), gridHits(steps.size());
+
+			double t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				for (int q = 0; q < steps.size(); q++)
+				{
+					const uint id = std::get<0>(steps[q]), i = std::get<1>(steps[q]);
+					linearHits[q] = collides(id,
+					                         chain.at(i).com(),
+					                         chain.begin(),
+					                         chain.begin() + i - 2,
+					                         db.radiiList);
+				}
+			linearTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				for (int q = 0; q < steps.size(); q++)
+				{
+					const uint id = std::get<0>(steps[q]), i = std::get<1>(steps[q]);
+					gridHits[q] = grid.collides(id,
+					                            chain.at(i).com(),
+					                            0,
+					                            i - 2);
+				}
+			gridTime += get_timestamp_us() - t0;
+
+			queries += (ulong) reps * steps.size();
+			for (int q = 0; q < linearHits.size(); q++)
+				mismatches += linearHits.at(q) != gridHits.at(q);
+		}
+
+		if (mismatches > 0)
+		{
+			failCount++;
+			err("Grid disagrees with linear scan on %lu queries\n", mismatches);
+		}
+
+		msg("len %u (avg %.1f genes): linear %.1fns/query, grid %.1fns/query (%.2fx)\n",
+		    len,
+		    (float) genes / chainsPerLen,
+		    linearTime * 1e3 / queries,
+		    gridTime * 1e3 / queries,
+		    linearTime / gridTime);
+	}
+
+	return failCount;
+}
+
+int _benchCollisionKernel()
+{
+	msg("Benchmarking collision scan: scalar collides() vs two-phase collidesSoA() (%d lanes)\n",
+	    COLLISION_KERNEL_LANES);
+
+	const uint lens[] = { 30, 60, 100 };
+	const CollisionMeasure measures[] = { AvgAll, MaxCA, MaxHeavy };
+	const uint chainsPerLen = 200;
+	const int reps = 20;
+
+	const BenchDB & db = setupBenchChromosome(100);
+	const CollisionNodes nodes(db.radiiList);
+
+	int failCount = 0;
+	uint seed = 0x600d1337;
+	for (const uint len : lens)
+	{
+		double scalarTime[3] = {}, kernelTime[3] = {};
+		ulong scanned = 0, mismatches = 0;
+
+		for (int c = 0; c < chainsPerLen; c++)
+		{
+			Genes chain;
+			do
+			{
+				chain = Chromosome::genRandomGenes(len);
+			}
+			while (chain.size() < len);
+
+			const uint n = chain.size();
+			CollisionSpheres spheres;
+			for (int i = 0; i < n; i++)
+				spheres.set(i, chain[i], nodes);
+
+			// Whole-chain scans from points near the chain,
+			// about a quarter of which collide
+			const uint probes = 32;
+			std::vector<Point3f> pts;
+			std::vector<uint> ids;
+			for (int p = 0; p < probes; p++)
+			{
+				pts.push_back(jitterPoints({chain.at(rand_r(&seed) % n).com()}, 60.0f, seed).at(0));
+				ids.push_back(chain.at(rand_r(&seed) % n).nodeId());
+			}
+
+			std::vector<bool> scalarHits(probes), kernelHits(probes);
+
+			for (int m = 0; m < 3; m++)
+			{
+				const CollisionMeasure measure = measures[m];
+
+				double t0 = get_timestamp_us();
+				for (int r = 0; r < reps; r++)
+					for (int p = 0; p < probes; p++)
+						scalarHits[p] = linearCollides(measure, ids[p], pts[p],
+						                               chain.begin(), chain.end(), db.radiiList);
+				scalarTime[m] += get_timestamp_us() - t0;
+
+				t0 = get_timestamp_us();
+				for (int r = 0; r < reps; r++)
+					for (int p = 0; p < probes; p++)
+					{
+						switch (measure)
+						{
+						case AvgAll:
+							kernelHits[p] = collidesSoA<AvgAll>(nodes, spheres, 0, n, ids[p], pts[p]);
+							break;
+						case MaxCA:
+							kernelHits[p] = collidesSoA<MaxCA>(nodes, spheres, 0, n, ids[p], pts[p]);
+							break;
+						default:
+							kernelHits[p] = collidesSoA<MaxHeavy>(nodes, spheres, 0, n, ids[p], pts[p]);
+						}
+					}
+				kernelTime[m] += get_timestamp_us() - t0;
+
+				for (int p = 0; p < probes; p++)
+					mismatches += scalarHits[p] != kernelHits[p];
+			}
+
+			scanned += (ulong) reps * probes;
+		}
+
+		if (mismatches > 0)
+		{
+			failCount++;
+			err("collidesSoA() disagrees with collides() on %lu scans\n", mismatches);
+		}
+
+		for (int m = 0; m < 3; m++)
+			msg("len %u %s: scalar %.1fns/scan, SoA %.1fns/scan (%.2fx)\n",
+			    len,
+			    CollisionMeasureString[measures[m]],
+			    scalarTime[m] * 1e3 / scanned,
+			    kernelTime[m] * 1e3 / scanned,
+			    scalarTime[m] / kernelTime[m]);
+	}
+
+	return failCount;
+}
+
+} // namespace elfin
@@ -0,0 +1,170 @@
+#ifndef _COLLISIONGRID_HPP_
+#define _COLLISIONGRID_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+#include "../data/Gene.hpp"
+
+// Hash buckets per grid; must be a power of two. Chains
+// are at most a few hundred genes, so collisions between
+// cells are rare and only cost extra exact checks
+#define COLLISION_GRID_BUCKETS 1024
+
+// Added to the cell size so that rounding never puts a
+// colliding gene outside the cells a query looks at
+#define COLLISION_GRID_SLACK 1.0f
+
+// Ranges of at most this many genes are scanned in full by
+// collidesSoA() rather than by cell
+#ifndef COLLISION_GRID_MIN_CELL_SCAN
+#define COLLISION_GRID_MIN_CELL_SCAN 48
+#endif
+
+// Genes tested per step of collidesSoA()
+#ifndef COLLISION_KERNEL_LANES
+#define COLLISION_KERNEL_LANES 8
+#endif
+
+namespace elfin
+{
+
+/*
+ * Per node radius bounds for the two-phase collision test.
+ * lo and hi are the smallest and largest radius of a node
+ * over all CollisionMeasures, so a pair closer than the sum
+ * of their lo collides under any measure and a pair at least
+ * the sum of their hi apart never does. Only pairs in
+ * between need the exact radius of the chosen measure.
+ */
+struct CollisionNodes
+{
+	std::vector<float> lo, hi;
+	RadiiList radii;
+
+	CollisionNodes() {};
+	CollisionNodes(const RadiiList & radiiList);
+
+	float maxRadius() const;
+};
+
+// Genes of a chain as SoA arrays indexed by gene
+struct CollisionSpheres
+{
+	std::vector<float> xs, ys, zs, lo, hi;
+	std::vector<uint> ids;
+
+	// Grows the arrays if geneIndex is past their end
+	void set(const uint geneIndex,
+	         const Gene & gene,
+	         const CollisionNodes & nodes);
+};
+
+/*
+ * Whether newId at pt collides with any of spheres [begin,
+ * end) under measure M, comparing squared distances with
+ * squared radius sums. COLLISION_KERNEL_LANES spheres are
+ * bound-tested per step: a certain overlap ends the scan,
+ * and only lanes in the ambiguous band look up their exact
+ * radius. Instantiated for every CollisionMeasure.
+ */
+template <CollisionMeasure M>
+bool collidesSoA(const CollisionNodes & nodes,
+                 const CollisionSpheres & spheres,
+                 const uint begin,
+                 const uint end,
+                 const uint newId,
+                 const Point3f & pt);
+
+/*
+ * Uniform spatial hash of the genes of a growing chain, used
+ * to find collision candidates without scanning every
+ * earlier gene. Genes must not move once inserted; synthesis
+ * places every gene once, in a fixed frame.
+ *
+ * Cells are as wide as the largest possible collision
+ * distance, so any gene a point can collide with is in one
+ * of the 27 cells around it. Genes are also kept as
+ * CollisionSpheres, so short ranges are tested with
+ * collidesSoA() instead.
+ *
+ * Both paths agree with collides<M>() in MathUtils.hpp for
+ * the measure given to setup(), which picks the matching
+ * instantiation once rather than per query.
+ */
+class CollisionGrid
+{
+public:
+	CollisionGrid();
+	virtual ~CollisionGrid() {};
+
+	void reset();
+
+	// reset() then insert every gene
+	void build(const Genes & genes);
+
+	// Add gene as the gene at geneIndex
+	void insert(const uint geneIndex, const Gene & gene);
+
+	uint size() const;
+
+	// Whether newId at newCOM collides with any gene whose
+	// index is in [beginIndex, endIndex); every gene in the
+	// range must have been inserted. An empty or inverted
+	// range never collides
+	bool collides(const uint newId,
+	              const Point3f & newCOM,
+	              const int beginIndex,
+	              const int endIndex) const;
+
+	// Sizes cells from the largest radius in the database
+	// and selects the collision measure; must be called
+	// before any grid is used
+	static void setup(const RadiiList & radiiList,
+	                  const CollisionMeasure measure = MaxHeavy);
+
+	// Radius of each node under the measure setup() selected
+	static const std::vector<float> & nodeRadii();
+
+private:
+	struct Entry
+	{
+		uint geneIndex;
+		uint bucket;
+		int next;
+	};
+
+	typedef bool (CollisionGrid::*Query)(const uint,
+	                                     const Point3f &,
+	                                     const int,
+	                                     const int) const;
+
+	std::vector<int> myHeads;
+	std::vector<Entry> myEntries;
+	CollisionSpheres mySpheres;
+
+	template <CollisionMeasure M>
+	bool query(const uint newId,
+	           const Point3f & newCOM,
+	           const int beginIndex,
+	           const int endIndex) const;
+
+	static void toCell(const Point3f & pt, int cell[3]);
+	static uint hashCell(const int x, const int y, const int z);
+
+	static float myCellSize;
+	static CollisionNodes myNodes;
+	static Query myQuery;
+	static std::vector<float> myNodeRadii;
+};
+
+// Per-thread grid for chain synthesis and growth
+CollisionGrid & getCollisionGrid();
+
+int _testCollisionGrid();
+int _benchCollisionGrid();
+int _benchCollisionKernel();
+
+} // namespace elfin
+
+#endif /* include guard */
@@ -3,12 +3,17 @@
 #include <algorithm>
 #include <omp.h>
 #include <stdlib.h>
-#include <unordered_map>
 #include <limits>
 
 #include "EvolutionSolver.hpp"
 #include "util.h"
 #include "ParallelUtils.hpp"
+#include "Kabsch.hpp"
+#include "SpecScoringContext.hpp"
+#include "AllocCounter.hpp"
+#include "WindowedKabsch.hpp"
+#include "RadixSort.hpp"
+#include "../data/ChainBatch.hpp"
 #include "../input/JSONParser.hpp"
 
 namespace elfin
@@ -25,20 +30,71 @@ EvolutionSolver::EvolutionSolver(const RelaMat & relaMat,
 	myRadiiList(radiiList),
 	myOptions(options)
 {
-	mySurviverCutoff = std::round(options.gaSurviveRate * options.gaPopSize);
+	// Islands split the population as evenly as possible
+	const ulong nIslands = options.gaIslands;
+	for (ulong k = 0; k < nIslands; k++)
+	{
+		const ulong begin = k * options.gaPopSize / nIslands;
+		const ulong end = (k + 1) * options.gaPopSize / nIslands;
+		myIslands.push_back(makeIsland(begin, end - begin));
+		myIslands.back().ranking.resize(end - begin);
+
+		panic_if(myIslands.back().surviverCutoff == 0,
+		         "Island %lu of %lu individuals keeps no survivors\n",
+		         k, end - begin);
+
+		addDedupSet(myIslands.back());
+
+		for (ulong i = begin; i < end; i++)
+		{
+			myIslandIds.push_back(k);
+			if (i - begin < myIslands.back().surviverCutoff)
+				mySurvivorIds.push_back(i);
+			else
+				myOffspringIds.push_back(i);
+		}
+	}
 
-	myNonSurviverCount = (options.gaPopSize - mySurviverCutoff);
-	myCrossCutoff = mySurviverCutoff + std::round(options.gaCrossRate * myNonSurviverCount);
-	myPointMutateCutoff = myCrossCutoff + std::round(options.gaPointMutateRate * myNonSurviverCount);
-	myLimbMutateCutoff = std::min(
-	                         (ulong) (myPointMutateCutoff + std::round(options.gaLimbMutateRate * myNonSurviverCount)),
-	                         (ulong) options.gaPopSize);
+	myChecksums.resize(options.gaPopSize);
+	myDedupSlots.resize(options.gaPopSize);
+	myRankWhere.resize(options.gaPopSize);
+	myRankWhat.resize(options.gaPopSize);
 
 	myExpectedTargetLen = Chromosome::calcExpectedLength(spec, options.avgPairDist);
 	myMinTargetLen = myExpectedTargetLen - myOptions.chromoLenDev;
 	myMaxTargetLen = myExpectedTargetLen + myOptions.chromoLenDev;
 
-	Chromosome::setup(myMinTargetLen, myMaxTargetLen, myRelaMat, myRadiiList);
+	Chromosome::setup(myMinTargetLen,
+	                  myMaxTargetLen,
+	                  myRelaMat,
+	                  myRadiiList,
+	                  myOptions.collisionMeasure);
+
+	mySpecContext = new SpecScoringContext(mySpec, myMinTargetLen, myMaxTargetLen);
+
+	setupScoringScratch(myMaxTargetLen, mySpec.size());
+
+	myWindowStep = windowStep(myOptions.windowLen, myOptions.windowOverlapRatio);
+
+	const size_t nOrigins = sizeof(OriginString) / sizeof(OriginString[0]);
+	myTotOperatorTimes.resize(nOrigins, 0.0);
+	myOperatorCalls.resize(nOrigins, 0);
+	myOperators.resize(myOptions.gaPopSize, Origin::New);
+	myOperatorTimes.resize(myOptions.gaPopSize, 0.0f);
+
+	// Growth only tracks the global fit
+	if (myOptions.incrementalScoring && myOptions.scoreMode == Windowed)
+		wrn("Incremental scoring is ignored in windowed score mode\n");
+	else if (myOptions.incrementalScoring)
+		Chromosome::setupIncrementalScoring(mySpecContext, myOptions.scoreBackend);
+}
+
+EvolutionSolver::~EvolutionSolver()
+{
+	if (myOptions.incrementalScoring && myOptions.scoreMode != Windowed)
+		Chromosome::setupIncrementalScoring(NULL, myOptions.scoreBackend);
+
+	delete mySpecContext;
 }
 
 const Population *
@@ -53,6 +109,12 @@ EvolutionSolver::bestSoFar() const
 	return myBestSoFar;
 }
 
+const SpecScoringContext &
+EvolutionSolver::specContext() const
+{
+	return *mySpecContext;
+}
+
 // Public methods
 
 void
@@ -73,10 +135,13 @@ EvolutionSolver::run()
 	const int genDispDigits = std::ceil(std::log(myOptions.gaIters) / std::log(10));
 	char * genMsgFmt;
 	asprintf(&genMsgFmt,
-	         "Generation #%%%dd: best=%%.2f (%%.2f/module), worst=%%.2f, time taken=%%.0fms\n", genDispDigits);
+	         "Generation #%%%dd: best=%%.2f (%%.2f/module), worst%%s%%.2f, time taken=%%.0fms\n", genDispDigits);
 	char * avgTimeMsgFmt;
 	asprintf(&avgTimeMsgFmt,
-	         "Avg Times: Evolve=%%.0f,Score=%%.0f,Rank=%%.0f,Select=%%.0f,Gen=%%.0f\n");
+	         "Avg Times: Evolve=%%.0f,Score=%%.0f,Rank=%%.0f,Sort=%%.0f,Select=%%.0f,Gen=%%.0f,ScoreAllocs=%%lu\n");
+	auto avgOperatorTime = [this](const Origin op) {
+		return myOperatorCalls.at(op) ? myTotOperatorTimes.at(op) / myOperatorCalls.at(op) : 0.0;
+	};
 	for (int i = 0; i < myOptions.gaIters; i++)
 	{
 		const double genStartTime = get_timestamp_us();
@@ -90,24 +155,56 @@ EvolutionSolver::run()
 
 			selectParents();
 
+			if (myIslands.size() > 1 && (i + 1) % myOptions.gaMigrateInterval == 0)
+				migrate();
+
 			swapPopBuffers();
 		}
 
-		const float genBestScore = myCurrPop->front().getScore();
-		const ulong genBestChromoLen = myCurrPop->front().genes().size();
-		const float genWorstScore = myCurrPop->back().getScore();
+		collectBest(nBestSoFar, myGenBest);
+		// Offspring bounded out of the survivor set only carry a
+		// lower bound, which makes the worst one too
+		float genWorstScore = 0.0f;
+		bool genWorstIsBound = false;
+		for (const auto & island : myIslands)
+		{
+			if (island.worstScore >= genWorstScore)
+			{
+				genWorstScore = island.worstScore;
+				genWorstIsBound = island.worstIsBound;
+			}
+		}
+
+		const float genBestScore = myGenBest.front().getScore();
+		const ulong genBestChromoLen = myGenBest.front().length();
 		const double genTime = ((get_timestamp_us() - genStartTime) / 1e3);
 		msg(genMsgFmt, i,
 		    genBestScore,
 		    genBestScore / genBestChromoLen,
+		    genWorstIsBound ? ">=" : "=",
 		    genWorstScore,
 		    genTime);
 		msg(avgTimeMsgFmt,
 		    (float) myTotEvolveTime / (i + 1),
 		    (float) myTotScoreTime / (i + 1),
 		    (float) myTotRankTime / (i + 1),
+		    (float) myTotSortTime / (i + 1),
 		    (float) myTotSelectTime / (i + 1),
-		    (float) myTotGenTime / (i + 1));
+		    (float) myTotGenTime / (i + 1),
+		    myLastScoreAllocs);
+		msg("Avg Operator Times (us/call): Cross=%.1f,PointMutate=%.1f,LimbMutate=%.1f,Random=%.1f\n",
+		    avgOperatorTime(Origin::Cross),
+		    avgOperatorTime(Origin::PointMutate),
+		    avgOperatorTime(Origin::LimbMutate),
+		    avgOperatorTime(Origin::Random));
+
+		const ulong randomiseRejects = Chromosome::randomiseRejects();
+		const ulong limbRegrowRetries = Chromosome::limbRegrowRetries();
+		msg("Growth rejections: Randomise=%lu,LimbRegrow=%lu\n",
+		    randomiseRejects - myLastRandomiseRejects,
+		    limbRegrowRetries - myLastLimbRegrowRetries);
+		myLastRandomiseRejects = randomiseRejects;
+		myLastLimbRegrowRetries = limbRegrowRetries;
 
 		myTotGenTime += genTime;
 
@@ -120,7 +217,7 @@ EvolutionSolver::run()
 		else
 		{
 			for (int i = 0; i < nBestSoFar; i++)
-				myBestSoFar.at(i) = myCurrPop->at(i);
+				myBestSoFar.at(i) = myGenBest.at(i);
 
 			if (float_approximates(genBestScore, lastGenBestScore))
 			{
@@ -145,6 +242,18 @@ EvolutionSolver::run()
 		}
 	}
 
+	// Islands are only ranked within themselves, and migrants
+	// leave copies behind; rank and select the whole population
+	// as one for whoever reads it next
+	if (myIslands.size() > 1)
+	{
+		Population * pop = const_cast<Population *>(myCurrPop);
+		Island whole = makeIsland(0, pop->size());
+		addDedupSet(whole);
+		rankIsland(*pop, whole, true);
+		selectIsland(*pop, whole);
+	}
+
 	this->printEndMsg();
 }
 
@@ -168,42 +277,50 @@ EvolutionSolver::evolvePopulation()
 		msg("Evolution: %.2f%% Done", (float) 0.0f);
 
 		ulong crossCount = 0, pmCount = 0, lmCount = 0, randCount = 0;
-		const ulong gaPopBlock = myOptions.gaPopSize / 10;
+		const ulong gaPopBlock = std::max(myOffspringIds.size() / 10, (size_t) 1);
 		ulong crossFailCount = 0;
 
 		Chromosome * myBuffPopData = myBuffPop->data();
 		size_t myBuffPopSize = myBuffPop->size();
 		const Chromosome * myCurrPopData = myCurrPop->data();
 		size_t myCurrPopSize = myCurrPop->size();
+		const ulong * survivorIds = mySurvivorIds.data();
+		const size_t nSurvivors = mySurvivorIds.size();
 		Chromosome & (Chromosome::*assign)(Chromosome const&) = &Chromosome::operator=;
 
 #ifdef _TARGET_GPU
-		#pragma omp target teams distribute parallel for simd schedule(runtime) map(myBuffPopData[0:myBuffPopSize], myCurrPopData[0:myCurrPopSize])
+		#pragma omp target teams distribute parallel for simd schedule(runtime) map(myBuffPopData[0:myBuffPopSize], myCurrPopData[0:myCurrPopSize], survivorIds[0:nSurvivors])
 #else
 		OMP_PAR_FOR
 #endif
-		for (int i = 0; i < mySurviverCutoff; i++)
-			(myBuffPopData[i].*assign)(myCurrPopData[i]);
+		for (int s = 0; s < nSurvivors; s++)
+			(myBuffPopData[survivorIds[s]].*assign)(myCurrPopData[survivorIds[s]]);
+
+		// Parents are drawn from the offspring's own island
+		const ulong nOffspring = myOffspringIds.size();
 
 		OMP_PAR_FOR
-		for (int i = mySurviverCutoff; i < myOptions.gaPopSize; i++)
+		for (int q = 0; q < nOffspring; q++)
 		{
+			const ulong i = myOffspringIds[q];
+			const Island & island = myIslands[myIslandIds[i]];
 			Chromosome & chromoToEvolve = myBuffPop->at(i);
-			const ulong evolutionDice = mySurviverCutoff +
-			                            getDice(myNonSurviverCount);
+			const ulong evolutionDice = island.surviverCutoff +
+			                            getDice(island.nonSurviverCount);
+			const double opStartTime = get_timestamp_us();
 
-			if (evolutionDice < myCrossCutoff)
+			if (evolutionDice < island.crossCutoff)
 			{
 				long motherId, fatherId;
 				if (getDice(2))
 				{
-					motherId = getDice(mySurviverCutoff);
-					fatherId = getDice(myOptions.gaPopSize);
+					motherId = island.begin + getDice(island.surviverCutoff);
+					fatherId = island.begin + getDice(island.size);
 				}
 				else
 				{
-					motherId = getDice(myOptions.gaPopSize);
-					fatherId = getDice(mySurviverCutoff);
+					motherId = island.begin + getDice(island.size);
+					fatherId = island.begin + getDice(island.surviverCutoff);
 				}
 
 				const Chromosome & mother = myCurrPop->at(motherId);
@@ -213,57 +330,94 @@ EvolutionSolver::evolvePopulation()
 				if (!mother.cross(father, chromoToEvolve))
 				{
 					// Pick a random parent to inherit from and then mutate
-					chromoToEvolve = mother.mutateChild();
+					mother.mutateChild(chromoToEvolve);
 					crossFailCount++;
 				}
 				crossCount++;
+				myOperators.at(i) = Origin::Cross;
 			}
-			else
+			else if (evolutionDice < island.limbMutateCutoff)
 			{
 				// Replicate a high ranking parent
-				const ulong parentId = getDice(mySurviverCutoff);
-				chromoToEvolve = myCurrPop->at(parentId).copy();
+				const ulong parentId = island.begin + getDice(island.surviverCutoff);
+				myCurrPop->at(parentId).copy(chromoToEvolve);
 
-				if (evolutionDice < myPointMutateCutoff)
+				if (evolutionDice < island.pointMutateCutoff)
 				{
 					if (!chromoToEvolve.pointMutate())
 						chromoToEvolve.randomise();
 					pmCount++;
+					myOperators.at(i) = Origin::PointMutate;
 				}
-				else if (evolutionDice < myLimbMutateCutoff)
+				else
 				{
 					if (!chromoToEvolve.limbMutate())
 						chromoToEvolve.randomise();
 					lmCount++;
-				}
-				else
-				{
-					// Individuals not covered by specified mutation
-					// rates undergo random destructive mutation
-					chromoToEvolve.randomise();
-					randCount++;
+					myOperators.at(i) = Origin::LimbMutate;
 				}
 			}
+			else
+			{
+				// Individuals not covered by specified mutation
+				// rates undergo random destructive mutation; they
+				// are grown in batches after this loop
+				randCount++;
+				myOperators.at(i) = Origin::Random;
+			}
+			myOperatorTimes.at(i) = get_timestamp_us() - opStartTime;
 
-			if (i % gaPopBlock == 0)
+			if (q % gaPopBlock == 0)
 			{
 				ERASE_LINE();
-				msg("Evolution: %.2f%% Done", (float) i / myOptions.gaPopSize);
+				msg("Evolution: %.2f%% Done", (float) q / nOffspring);
 			}
 		}
 
 		ERASE_LINE();
 		msg("Evolution: 100%% Done\n");
 
+		myRandomQueue.clear();
+		for (const ulong i : myOffspringIds)
+			if (myOperators.at(i) == Origin::Random)
+				myRandomQueue.push_back(&myBuffPop->at(i));
+
+		const ulong randBatches =
+		    (myRandomQueue.size() + CHAIN_BATCH_LANES - 1) / CHAIN_BATCH_LANES;
+
+		OMP_PAR_FOR
+		for (int b = 0; b < randBatches; b++)
+		{
+			const ulong begin = b * CHAIN_BATCH_LANES;
+			const ulong count = std::min((ulong) CHAIN_BATCH_LANES,
+			                             myRandomQueue.size() - begin);
+			const double batchStartTime = get_timestamp_us();
+
+			getChainBatch().randomiseEach(myRandomQueue.data() + begin, count);
+
+			// Each individual is charged its share of the batch
+			const float share = (get_timestamp_us() - batchStartTime) / count;
+			for (ulong r = begin; r < begin + count; r++)
+				myOperatorTimes.at(myRandomQueue.at(r) - myBuffPop->data()) = share;
+		}
+
+		// Fallback randomise() calls count towards the
+		// operator that failed
+		for (const ulong i : myOffspringIds)
+		{
+			myTotOperatorTimes.at(myOperators.at(i)) += myOperatorTimes.at(i);
+			myOperatorCalls.at(myOperators.at(i))++;
+		}
+
 		// Keep some actual counts to make sure the RNG is working
 		// correctly
-		dbg("Mutation rates: cross %.2f (fail=%d), pm %.2f, lm %.2f, rand %.2f, survivalCount: %d\n",
-		    (float) crossCount / myNonSurviverCount,
+		dbg("Mutation rates: cross %.2f (fail=%d), pm %.2f, lm %.2f, rand %.2f, survivalCount: %lu\n",
+		    (float) crossCount / nOffspring,
 		    crossFailCount,
-		    (float) pmCount / myNonSurviverCount,
-		    (float) lmCount / myNonSurviverCount,
-		    (float) randCount / myNonSurviverCount,
-		    mySurviverCutoff);
+		    (float) pmCount / nOffspring,
+		    (float) lmCount / nOffspring,
+		    (float) randCount / nOffspring,
+		    nSurvivors);
 	}
 	myTotEvolveTime += TIMING_END("evolving", startTimeEvolving);
 
@@ -278,25 +432,143 @@ EvolutionSolver::scorePopulation()
 	TIMING_START(startTimeScoring);
 	{
 		msg("Scoring: 0%% Done");
-		const ulong scoreBlock = myOptions.gaPopSize / 10;
-
-		OMP_PAR_FOR
-		for (int i = 0; i < myOptions.gaPopSize; i++)
+		const ulong allocCountStart = getAllocCount();
+
+		// Survivors and unmodified copies still hold a valid
+		// score; only queue the individuals that changed
+		myScoreQueue.clear();
+		for (ulong i = 0; i < myOptions.gaPopSize; i++)
+			if (!myBuffPop->at(i).scoreValid())
+				myScoreQueue.push_back(i);
+
+		// Offspring whose score bound already exceeds the worst
+		// survivor cannot enter the survivor set, so they keep
+		// the bound and skip the full Kabsch
+		const float boundCutoff = survivorScoreCutoff();
+		const bool useBound = boundCutoff < INFINITY;
+
+		// Each thread fills the lanes of its own SoA block and
+		// scores it with the batched Kabsch kernel when full
+		const ulong queueSize = myScoreQueue.size();
+		const ulong scoreBlock = std::max(queueSize / 10, (ulong) 1);
+		ulong boundSkips = 0;
+
+		#pragma omp parallel reduction(+:boundSkips)
 		{
-			myBuffPop->at(i).score(mySpec);
-			if (i % scoreBlock == 0)
+			KabschBatch & batch = getScoringScratch().batch;
+			float scores[KABSCH_BATCH_LANES];
+			ulong laneIds[KABSCH_BATCH_LANES];
+			uint nLanes = 0;
+
+			auto scoreLanes = [&]() {
+				kabschScoreBatch(batch, *mySpecContext, scores,
+				                 myOptions.scoreBackend,
+				                 myOptions.scorePrecision);
+
+				for (int l = 0; l < nLanes; l++)
+					myBuffPop->at(laneIds[l]).setScore(scores[l]);
+
+				nLanes = 0;
+			};
+
+			#pragma omp for schedule(runtime) nowait
+			for (ulong q = 0; q < queueSize; q++)
 			{
-				ERASE_LINE();
-				msg("Scoring: %.2f%% Done",
-				    (float) i / myOptions.gaPopSize);
+				const ulong id = myScoreQueue[q];
+				const Chromosome & chromo = myBuffPop->at(id);
+
+				if (myOptions.scoreMode == Windowed)
+				{
+					const WindowStats ws = windowedKabsch(chromo.genes(),
+					                                      *mySpecContext,
+					                                      myOptions.windowLen,
+					                                      myWindowStep,
+					                                      myOptions.scoreBackend);
+					myBuffPop->at(id).setScore(ws.sum);
+					continue;
+				}
+
+				batch.load(nLanes, chromo.genes(), *mySpecContext);
+
+				if (useBound)
+				{
+					const float bound = kabschLowerBound(batch, nLanes, *mySpecContext);
+					if (bound > boundCutoff)
+					{
+						myBuffPop->at(id).setScoreBound(bound);
+						boundSkips++;
+						continue;
+					}
+				}
+
+				laneIds[nLanes++] = id;
+				if (nLanes == KABSCH_BATCH_LANES)
+					scoreLanes();
+
+				if (q % scoreBlock == 0)
+				{
+					ERASE_LINE();
+					msg("Scoring: %.2f%% Done",
+					    (float) q / queueSize);
+				}
 			}
+
+			// Lanes past nLanes hold stale shapes whose scores
+			// are never read back
+			if (nLanes > 0)
+				scoreLanes();
 		}
+
+		const ulong skipped = myOptions.gaPopSize - queueSize;
+		myTotScoreSkips += skipped;
+		myTotBoundSkips += boundSkips;
+
 		ERASE_LINE();
-		msg("Scoring: 100%% Done\n");
+		msg("Scoring: 100%% Done, %lu clean individuals skipped, %lu bounded\n",
+		    skipped, boundSkips);
+
+		myLastScoreAllocs = getAllocCount() - allocCountStart;
 	}
 	myTotScoreTime += TIMING_END("scoring", startTimeScoring);
 }
 
+/*
+ * Survivors are carried into the next generation with exact
+ * scores, so its survivor set can be no worse than the worst
+ * of them. That only holds when they are all distinct, as
+ * selectParents() would skip duplicates. Each island keeps
+ * its own survivors, so the worst over all islands holds for
+ * every one of them.
+ */
+float
+EvolutionSolver::survivorScoreCutoff() const
+{
+	// The bound is on the global fit only
+	if (!myOptions.lowerBoundFilter ||
+	        myOptions.scoreMode == Windowed)
+		return INFINITY;
+
+	for (const auto & island : myIslands)
+		if (island.lastUniqueCount < island.surviverCutoff)
+			return INFINITY;
+
+	float worst = 0.0f;
+	for (const ulong i : mySurvivorIds)
+	{
+		const Chromosome & chromo = myBuffPop->at(i);
+		if (!chromo.scoreValid())
+			return INFINITY;
+		worst = std::max(worst, chromo.getScore());
+	}
+
+	return worst;
+}
+
+/*
+ * Each island is ranked as a list of (score key, index) pairs,
+ * radix sorted; chromosomes stay where they are until
+ * selectIsland() moves the survivors it keeps to the front.
+ */
 void
 EvolutionSolver::rankPopulation()
 {
@@ -304,49 +576,241 @@ EvolutionSolver::rankPopulation()
 	// (low score = more fit)
 	TIMING_START(startTimeRanking);
 	{
-		std::sort(myBuffPop->begin(),
-		          myBuffPop->end());
+		const Chromosome * members = myBuffPop->data();
+
+		// Even and cheap per item, unlike what the runtime
+		// schedule is tuned for
+		#pragma omp parallel for schedule(static)
+		for (ulong i = 0; i < myOptions.gaPopSize; i++)
+		{
+			Island & island = myIslands[myIslandIds[i]];
+			island.ranking[i - island.begin] =
+			    radixItem(floatSortKey(members[i].getScore()), i - island.begin);
+		}
+
+		TIMING_START(startTimeSorting);
+		{
+			// Islands are sorted one per thread
+			#pragma omp parallel for schedule(dynamic) if (myIslands.size() > 1)
+			for (int k = 0; k < myIslands.size(); k++)
+				rankIsland(*myBuffPop, myIslands[k], false);
+		}
+		myTotSortTime += TIMING_END("sorting", startTimeSorting);
 	}
 	myTotRankTime += TIMING_END("ranking", startTimeRanking);
 }
 
+/*
+ * Sorts the island's ranking, filling it with every member's
+ * score first if fill is set
+ */
+void
+EvolutionSolver::rankIsland(const Population & pop,
+                            Island & island,
+                            const bool fill)
+{
+	const Chromosome * members = pop.data() + island.begin;
+
+	island.ranking.resize(island.size);
+	if (fill)
+	{
+		for (ulong i = 0; i < island.size; i++)
+			island.ranking[i] = radixItem(floatSortKey(members[i].getScore()), i);
+	}
+
+	radixSortKeys(island.ranking, island.rankScratch);
+	island.worstScore = members[radixPayload(island.ranking.back())].getScore();
+
+	// A bounded member's real score may lie anywhere above its
+	// bound, so with any of them the worst is only a bound
+	island.worstIsBound = std::any_of(members, members + island.size,
+	[](const Chromosome & c) {
+		return c.scoreIsBound();
+	});
+}
+
 void
 EvolutionSolver::selectParents()
 {
 	TIMING_START(startTimeSelectParents);
 	{
-		// Ensure variety within survivors using hashmap
-		// and crc as key
-		using CrcMap = std::unordered_map<Crc32, Chromosome>;
-		CrcMap crcMap;
-		ulong uniqueCount = 0;
-
-		// We don't want parallelism here because
-		// the loop must priotise low indexes
-		for (int i = 0; i < myBuffPop->size(); i++)
+		#pragma omp parallel for schedule(dynamic) if (myIslands.size() > 1)
+		for (int k = 0; k < myIslands.size(); k++)
+			selectIsland(*myBuffPop, myIslands[k]);
+	}
+	myTotSelectTime += TIMING_END("selecting", startTimeSelectParents);
+}
+
+/*
+ * Ensures variety within survivors: going down the island's
+ * ranking, keeps the first cutoff distinct checksums, each at
+ * its lowest rank, and moves them to the front in rank order.
+ *
+ * Ranks are taken in blocks, no more than are needed if all
+ * are distinct. A block is checksummed and entered into the
+ * island's checksum set in parallel, where the lowest rank
+ * wins a checksum; earlier blocks are all in by then, so a
+ * block's winners are final and are swapped forward in order,
+ * tracking where every member has moved to.
+ */
+void
+EvolutionSolver::selectIsland(Population & pop, Island & island)
+{
+	Chromosome * members = pop.data() + island.begin;
+	Crc32 * crcs = myChecksums.data() + island.begin;
+	uint * slots = myDedupSlots.data() + island.begin;
+	uint * where = myRankWhere.data() + island.begin; // Position by member
+	uint * what = myRankWhat.data() + island.begin; // Member by position
+	uint * set = myDedupSet.data() + island.dedupBase;
+	const uint mask = (1u << island.dedupBits) - 1;
+	const ulong * ranking = island.ranking.data();
+
+	#pragma omp parallel for schedule(static)
+	for (ulong i = 0; i < island.size; i++)
+		where[i] = what[i] = i;
+
+	ulong uniqueCount = 0, end = 0;
+	for (ulong begin = 0;
+	        begin < island.size && uniqueCount < island.surviverCutoff;
+	        begin = end)
+	{
+		end = std::min(island.size,
+		               begin + std::max(island.surviverCutoff - uniqueCount,
+		                                (ulong) SELECT_DEDUP_BLOCK));
+
+		#pragma omp parallel for schedule(runtime)
+		for (ulong r = begin; r < end; r++)
 		{
-			const Crc32 crc = myBuffPop->at(i).checksum();
-			if (crcMap.find(crc) == crcMap.end())
+			const Crc32 crc = members[where[radixPayload(ranking[r])]].checksum();
+			crcs[r] = crc;
+
+			uint s = (crc * 2654435761u) >> (32 - island.dedupBits);
+			for (;; s = (s + 1) & mask)
 			{
-				// This individual is a new one - record
-				crcMap[crc] = myBuffPop->at(i);
-				uniqueCount++;
+				uint held = __atomic_load_n(&set[s], __ATOMIC_ACQUIRE);
+				if (held == 0 &&
+				        __atomic_compare_exchange_n(&set[s], &held, r + 1, false,
+				                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+					break;
 
-				if (uniqueCount >= mySurviverCutoff)
+				// A failed exchange left the new holder in held
+				if (held != 0 && crcs[held - 1] == crc)
+				{
+					while (r + 1 < held &&
+					        !__atomic_compare_exchange_n(&set[s], &held, r + 1, false,
+					                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 					break;
+				}
 			}
+			slots[r] = s;
+		}
+
+		for (ulong r = begin; r < end && uniqueCount < island.surviverCutoff; r++)
+		{
+			if (set[slots[r]] != r + 1)
+				continue;
+
+			const uint id = radixPayload(ranking[r]);
+			const uint from = where[id];
+			const uint to = uniqueCount++;
+			if (from == to)
+				continue;
+
+			members[to].swap(members[from]);
+			where[what[to]] = from;
+			what[from] = what[to];
+			where[id] = to;
+			what[to] = id;
+		}
+	}
+
+	// Leave the set empty for next time
+	for (ulong r = 0; r < end; r++)
+		set[slots[r]] = 0;
+
+	island.lastUniqueCount = uniqueCount;
+}
+
+/*
+ * Every island sends copies of its best survivors to the next
+ * island (Ring) or to all others (Full). Migrants compete with
+ * the receiving island's survivors on score, so they only
+ * displace worse ones, and are dropped if the island already
+ * holds the same chromosome. Counted as selection time.
+ */
+void
+EvolutionSolver::migrate()
+{
+	TIMING_START(startTimeMigrating);
+	{
+		const uint nIslands = myIslands.size();
+
+		// Take migrants first, so that none are passed on by the
+		// island that just received them
+		Population migrants;
+		std::vector<ulong> migrantBase;
+		for (const auto & island : myIslands)
+		{
+			migrantBase.push_back(migrants.size());
+			const ulong n = std::min((ulong) myOptions.gaMigrateCount,
+			                         island.lastUniqueCount);
+			for (ulong m = 0; m < n; m++)
+				migrants.push_back(myBuffPop->at(island.begin + m));
 		}
+		migrantBase.push_back(migrants.size());
 
-		// Insert map-value-indexed individual back into population
-		ulong popIndex = 0;
-		for (CrcMap::iterator it = crcMap.begin(); it != crcMap.end(); ++it)
-			myBuffPop->at(popIndex++) = it->second;
+		ulong settled = 0;
+
+		#pragma omp parallel for schedule(dynamic) reduction(+:settled)
+		for (int k = 0; k < nIslands; k++)
+		{
+			Island & island = myIslands[k];
+			Chromosome * members = myBuffPop->data() + island.begin;
+
+			Population pool(members, members + island.lastUniqueCount);
+			std::vector<Crc32> crcs;
+			for (const auto & c : pool)
+				crcs.push_back(c.checksum());
+
+			for (uint s = 0; s < nIslands; s++)
+			{
+				const bool sends = myOptions.gaMigrateTopology == Full ?
+				                   s != k : s == (k + nIslands - 1) % nIslands;
+				if (!sends)
+					continue;
+
+				for (ulong m = migrantBase[s]; m < migrantBase[s + 1]; m++)
+				{
+					const Crc32 crc = migrants[m].checksum();
+					if (std::find(crcs.begin(), crcs.end(), crc) != crcs.end())
+						continue;
+
+					pool.push_back(migrants[m]);
+					crcs.push_back(crc);
+				}
+			}
+
+			// Rank by index to tell migrants (past the natives)
+			// from natives
+			std::vector<ulong> order(pool.size());
+			for (ulong i = 0; i < order.size(); i++)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&pool](const ulong a, const ulong b) {
+				return pool[a] < pool[b];
+			});
+
+			const ulong natives = island.lastUniqueCount;
+			island.lastUniqueCount = std::min((ulong) pool.size(), island.surviverCutoff);
+			for (ulong i = 0; i < island.lastUniqueCount; i++)
+			{
+				settled += order[i] >= natives;
+				members[i] = pool[order[i]];
+			}
+		}
 
-		// Sort survivors
-		std::sort(myBuffPop->begin(),
-		          myBuffPop->begin() + uniqueCount);
+		myTotMigrants += settled;
 	}
-	myTotSelectTime += TIMING_END("selecting", startTimeSelectParents);
+	myTotSelectTime += TIMING_END("migrating", startTimeMigrating);
 }
 
 void
@@ -357,34 +821,120 @@ EvolutionSolver::swapPopBuffers()
 	myBuffPop = const_cast<Population *>(tmp);
 }
 
+/*
+ * Places a checksum set for the island at the end of
+ * myDedupSet; at most half full even if every individual is
+ * distinct
+ */
+void
+EvolutionSolver::addDedupSet(Island & island)
+{
+	island.dedupBits = 1;
+	while ((1ul << island.dedupBits) < 2 * island.size)
+		island.dedupBits++;
+
+	island.dedupBase = myDedupSet.size();
+	myDedupSet.resize(myDedupSet.size() + (1ul << island.dedupBits));
+}
+
+EvolutionSolver::Island
+EvolutionSolver::makeIsland(const ulong begin, const ulong size) const
+{
+	Island island;
+	island.begin = begin;
+	island.size = size;
+	island.surviverCutoff = std::round(myOptions.gaSurviveRate * size);
+
+	island.nonSurviverCount = (size - island.surviverCutoff);
+	island.crossCutoff = island.surviverCutoff +
+	                     std::round(myOptions.gaCrossRate * island.nonSurviverCount);
+	island.pointMutateCutoff = island.crossCutoff +
+	                           std::round(myOptions.gaPointMutateRate * island.nonSurviverCount);
+	island.limbMutateCutoff = std::min(
+	                              (ulong) (island.pointMutateCutoff +
+	                                       std::round(myOptions.gaLimbMutateRate * island.nonSurviverCount)),
+	                              size);
+
+	return island;
+}
+
+/*
+ * Best n individuals of the current population over all
+ * islands, best first; each island is ranked, so only its
+ * first n can be among them
+ */
+void
+EvolutionSolver::collectBest(const ulong n, Population & out) const
+{
+	std::vector<const Chromosome *> tops;
+	for (const auto & island : myIslands)
+		for (ulong i = 0; i < std::min(n, island.size); i++)
+			tops.push_back(&myCurrPop->at(island.begin + i));
+
+	const ulong count = std::min(n, (ulong) tops.size());
+	std::partial_sort(tops.begin(), tops.begin() + count, tops.end(),
+	[](const Chromosome * a, const Chromosome * b) {
+		return *a < *b;
+	});
+
+	out.resize(count);
+	for (ulong i = 0; i < count; i++)
+		out.at(i) = *tops.at(i);
+}
+
 void
 EvolutionSolver::initPopulation()
 {
 	TIMING_START(startTimeInit);
 	{
-		myPopulationBuffers[0] = Population(myOptions.gaPopSize);
-		myPopulationBuffers[1] = Population(myOptions.gaPopSize);
+		// Every member keeps its genes in its own slot of its
+		// buffer's slab, for good, or only its node IDs when
+		// compact; neither population may be resized after this
+		for (int p = 0; p < 2; p++)
+		{
+			Population & pop = myPopulationBuffers[p];
+			pop = Population(myOptions.gaPopSize);
+			if (myOptions.compactPopulation)
+			{
+				for (ulong i = 0; i < myOptions.gaPopSize; i++)
+					pop[i].setCompact(true);
+				continue;
+			}
+
+			myGeneSlabs[p].reset(myOptions.gaPopSize, Chromosome::maxLen());
+			for (ulong i = 0; i < myOptions.gaPopSize; i++)
+				pop[i].genes().bind(myGeneSlabs[p].slot(i), Chromosome::maxLen());
+		}
+		myScoreQueue.reserve(myOptions.gaPopSize);
 		myCurrPop = &(myPopulationBuffers[0]);
 		myBuffPop = &(myPopulationBuffers[1]);
 
-		const ulong block = myOptions.gaPopSize / 10;
+		// Chains are grown CHAIN_BATCH_LANES at a time
+		const ulong batches =
+		    (myOptions.gaPopSize + CHAIN_BATCH_LANES - 1) / CHAIN_BATCH_LANES;
+		const ulong block = std::max(batches / 10, 1ul);
 
 		msg("Initialising population: %.2f%% Done", 0.0f);
 
 		OMP_PAR_FOR
-		for (int i = 0; i < myOptions.gaPopSize; i++)
+		for (int b = 0; b < batches; b++)
 		{
-			myBuffPop->at(i).randomise();
-			if (i % block == 0)
+			const ulong begin = b * CHAIN_BATCH_LANES;
+			getChainBatch().randomise(myBuffPop->data() + begin,
+			                          std::min((ulong) CHAIN_BATCH_LANES,
+			                                   myOptions.gaPopSize - begin));
+			if (b % block == 0)
 			{
 				ERASE_LINE();
-				msg("Initialising population: %.2f%% Done", (float) i / myOptions.gaPopSize);
+				msg("Initialising population: %.2f%% Done", (float) b / batches);
 			}
 		}
 
 		ERASE_LINE();
 		msg("Initialising population: 100%% done\n");
 
+		myLastRandomiseRejects = Chromosome::randomiseRejects();
+		msg("Grown chains rejected while initialising: %lu\n", myLastRandomiseRejects);
 	}
 	TIMING_END("init", startTimeInit);
 
@@ -419,6 +969,9 @@ EvolutionSolver::printStartMsg()
 		niStr << myOptions.gaIters;
 
 
+	// Cutoffs are per island
+	const Island & firstIsland = myIslands.front();
+
 	msg("EvolutionSolver starting with following settings:\n"
 	    "Population size:            %s\n"
 	    "Iterations:                 %s\n"
@@ -426,14 +979,37 @@ EvolutionSolver::printStartMsg()
 	    "Cross cutoff:               %u\n"
 	    "Point Mutate cutoff:        %u\n"
 	    "Limb Mutate cutoff:         %u\n"
-	    "New species:                %u\n",
+	    "New species:                %u\n"
+	    "Score backend:              %s (%s)\n"
+	    "Incremental scoring:        %s\n"
+	    "Lower bound filter:         %s\n"
+	    "Population genes:           %s\n"
+	    "Collision measure:          %s\n"
+	    "Score mode:                 %s (window %u, step %u)\n",
 	    psStr.str().c_str(),
 	    niStr.str().c_str(),
-	    mySurviverCutoff,
-	    myCrossCutoff,
-	    myPointMutateCutoff,
-	    myLimbMutateCutoff,
-	    myOptions.gaPopSize - myLimbMutateCutoff);
+	    firstIsland.surviverCutoff,
+	    firstIsland.crossCutoff,
+	    firstIsland.pointMutateCutoff,
+	    firstIsland.limbMutateCutoff,
+	    firstIsland.size - firstIsland.limbMutateCutoff,
+	    ScoreBackendString[myOptions.scoreBackend],
+	    ScorePrecisionString[myOptions.scorePrecision],
+	    myOptions.incrementalScoring ? "on" : "off",
+	    myOptions.lowerBoundFilter ? "on" : "off",
+	    myOptions.compactPopulation ? "node IDs only" : "placed",
+	    CollisionMeasureString[myOptions.collisionMeasure],
+	    ScoreModeString[myOptions.scoreMode],
+	    myOptions.windowLen,
+	    myWindowStep);
+
+	if (myIslands.size() > 1)
+		msg("Islands:                    %lu of %lu (%s migration of %u every %u generations)\n",
+		    myIslands.size(),
+		    firstIsland.size,
+		    MigrateTopologyString[myOptions.gaMigrateTopology],
+		    myOptions.gaMigrateCount,
+		    myOptions.gaMigrateInterval);
 
 	#pragma omp parallel
 	{
@@ -447,6 +1023,13 @@ EvolutionSolver::printEndMsg()
 {
 	msg("EvolutionSolver finished: ");
 	this->printTiming();
+	msg("Score evaluations skipped for clean individuals: %lu\n", myTotScoreSkips);
+	msg("Full evaluations avoided by lower bound: %lu\n", myTotBoundSkips);
+	if (myIslands.size() > 1)
+		msg("Migrants settled on other islands: %lu\n", myTotMigrants);
+	msg("Grown chains rejected: randomise %lu, limb regrow %lu\n",
+	    Chromosome::randomiseRejects(),
+	    Chromosome::limbRegrowRetries());
 
 	// Print best N solutions
 	const ulong N = 3;
@@ -1,8 +1,17 @@
 #ifndef _EVOLUTIONSOLVER_HPP_
 #define _EVOLUTIONSOLVER_HPP_
 
+#include <cmath>
+
 #include "../data/TypeDefs.hpp"
 #include "../data/Chromosome.hpp"
+#include "SpecScoringContext.hpp"
+
+// Individuals checksummed per step of selectParents(), at
+// least; it stops as soon as enough survivors are found
+#ifndef SELECT_DEDUP_BLOCK
+#define SELECT_DEDUP_BLOCK 4096
+#endif
 
 namespace elfin
 {
@@ -16,10 +25,11 @@ public:
 	                const Points3f & spec,
 	                const RadiiList & radiiList,
 	                const OptionPack & options);
-	virtual ~EvolutionSolver() {};
+	virtual ~EvolutionSolver();
 
 	const Population * population() const;
 	const Population & bestSoFar() const;
+	const SpecScoringContext & specContext() const;
 
 	void run();
 private:
@@ -27,35 +37,99 @@ private:
 	const Points3f & mySpec;
 	const RadiiList & myRadiiList;
 	const OptionPack & myOptions;
+	const SpecScoringContext * mySpecContext = NULL;
 
 	uint myExpectedTargetLen;
 	uint myMinTargetLen;
 	uint myMaxTargetLen;
-	ulong myNonSurviverCount;
-	ulong mySurviverCutoff;
-	ulong myCrossCutoff;
-	ulong myPointMutateCutoff;
-	ulong myLimbMutateCutoff;
+
+	// A contiguous range of the population that evolves, ranks
+	// and selects on its own; cutoffs are relative to begin
+	struct Island
+	{
+		ulong begin;
+		ulong size;
+		ulong nonSurviverCount;
+		ulong surviverCutoff;
+		ulong crossCutoff;
+		ulong pointMutateCutoff;
+		ulong limbMutateCutoff;
+		ulong lastUniqueCount = 0; // Unique survivors found by selectParents()
+		ulong dedupBase; // First slot of the island's checksum set
+		uint dedupBits; // The set has 2^dedupBits slots
+
+		// Members by rank, as radixItem()s of score key and
+		// index relative to begin; set by rankPopulation()
+		std::vector<ulong> ranking;
+		std::vector<ulong> rankScratch;
+		float worstScore = INFINITY;
+		bool worstIsBound = false; // worstScore is a lower bound
+	};
+	std::vector<Island> myIslands;
+	std::vector<uint> myIslandIds; // Island of each individual
+	std::vector<ulong> mySurvivorIds; // Survivor slots of all islands
+	std::vector<ulong> myOffspringIds; // All other slots
+
+	// Survivor selection scratch: checksums and their slots
+	// by individual, and every island's open-addressing set of
+	// checksums; a slot holds 1 + the lowest index (relative to
+	// the island) seen with its checksum, or 0 if empty
+	std::vector<Crc32> myChecksums;
+	std::vector<uint> myDedupSlots;
+	std::vector<uint> myDedupSet;
+	std::vector<uint> myRankWhere; // Where selectIsland() moved each member
+	std::vector<uint> myRankWhat; // Which member is now in each slot
 
 	double myStartTimeInUs = 0;
+	GeneSlab myGeneSlabs[2]; // Gene storage of each buffer
 	Population myPopulationBuffers[2]; // double buffer
 	const Population *myCurrPop;
 	Population *myBuffPop;
 	Population myBestSoFar; // Currently used for emergency output
+	Population myGenBest; // Best of the last generation over all islands
 
 	double myTotEvolveTime = 0.0f;
 	double myTotScoreTime = 0.0f;
 	double myTotRankTime = 0.0f;
+	double myTotSortTime = 0.0f; // Part of rank time
 	double myTotSelectTime = 0.0f;
 	double myTotGenTime = 0.0f;
+	ulong myLastScoreAllocs = 0; // Heap allocations made by the last scoring phase
+	ulong myTotScoreSkips = 0;
+	ulong myTotBoundSkips = 0; // Full evaluations avoided by lower bounds
+	ulong myTotMigrants = 0; // Individuals that settled on another island
+
+	// Evolution operator costs, indexed by the Origin each
+	// operator stands for: summed time (us) and call count
+	std::vector<double> myTotOperatorTimes;
+	std::vector<ulong> myOperatorCalls;
+	// Last generation's operator and its time by individual
+	std::vector<Origin> myOperators;
+	std::vector<float> myOperatorTimes;
+	std::vector<Chromosome *> myRandomQueue; // Regrown by ChainBatch
+
+	// Chromosome growth counters at the end of the last
+	// generation
+	ulong myLastRandomiseRejects = 0;
+	ulong myLastLimbRegrowRetries = 0;
+	uint myWindowStep = 1;
+	std::vector<ulong> myScoreQueue; // Indices of individuals needing a score
 
 	void initPopulation();
 	void evolvePopulation();
 	void scorePopulation();
+	float survivorScoreCutoff() const;
 	void rankPopulation();
+	void rankIsland(const Population & pop, Island & island, const bool fill);
 	void selectParents();
+	void selectIsland(Population & pop, Island & island);
+	void migrate();
 	void swapPopBuffers();
 
+	Island makeIsland(const ulong begin, const ulong size) const;
+	void addDedupSet(Island & island);
+	void collectBest(const ulong n, Population & out) const;
+
 	void printStartMsg();
 	void printEndMsg();
 	void startTimer();
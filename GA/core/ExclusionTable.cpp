@@ -0,0 +1,230 @@
+#include "ExclusionTable.hpp"
+
+#include <cmath>
+
+#include "util.h"
+#include "MathUtils.hpp"
+#include "../data/Geometry.hpp"
+#include "../data/PairRelationship.hpp"
+#include "../input/JSONParser.hpp"
+
+namespace elfin
+{
+
+// Static variables
+uint ExclusionTable::myDim = 0;
+std::vector<int> ExclusionTable::myPairs;
+std::vector<uint> ExclusionTable::myLhsPos;
+std::vector<uint> ExclusionTable::myRhsPos;
+std::vector<uint> ExclusionTable::myTripleBase;
+std::vector<uint> ExclusionTable::myRowBase;
+std::vector<char> ExclusionTable::myRows;
+ulong ExclusionTable::myExcludedCount = 0;
+
+/*
+ * Whether d collides with a in the stretch a, b, c, d, with
+ * a at the origin of its own frame
+ */
+static bool
+stretchCollides(const PairRelationship * ab,
+                const PairRelationship * bc,
+                const PairRelationship * cd,
+                const float reach)
+{
+	// As Chromosome::GrowthFrames::growForward()
+	const RigidTransform toB = RigidTransform::inverse(ab->rotInv, ab->tran);
+	const RigidTransform toC = RigidTransform::inverse(bc->rotInv, bc->tran).then(toB);
+	const Point3f pt = toC.apply(cd->comB);
+
+	return pt.x * pt.x + pt.y * pt.y + pt.z * pt.z < reach * reach;
+}
+
+void
+ExclusionTable::setup(const RelaMat & relaMat,
+                      const std::vector<float> & radii)
+{
+	const uint dim = relaMat.size();
+	panic_if(radii.size() != dim,
+	         "ExclusionTable::setup(): %lu radii for %u nodes\n",
+	         radii.size(), dim);
+
+	myDim = dim;
+	myPairs.assign(dim * dim, -1);
+	myLhsPos.assign(dim * dim, 0);
+	myRhsPos.assign(dim * dim, 0);
+
+	std::vector<std::vector<uint>> lhs(dim), rhs(dim);
+	int pairCount = 0;
+	for (uint i = 0; i < dim; i++)
+	{
+		for (uint j = 0; j < dim; j++)
+		{
+			if (relaMat.at(i).at(j) == NULL)
+				continue;
+
+			myPairs.at(i * dim + j) = pairCount++;
+			myRhsPos.at(i * dim + j) = rhs.at(i).size();
+			rhs.at(i).push_back(j);
+			myLhsPos.at(j * dim + i) = lhs.at(j).size();
+			lhs.at(j).push_back(i);
+		}
+	}
+
+	// Pairs are numbered in (b, c) order, so triples and rows
+	// are laid out in the same order
+	myTripleBase.clear();
+	myRowBase.clear();
+	myRows.clear();
+	myExcludedCount = 0;
+	for (uint b = 0; b < dim; b++)
+	{
+		for (const uint c : rhs.at(b))
+		{
+			myTripleBase.push_back(myRowBase.size());
+			const PairRelationship * bc = relaMat.at(b).at(c);
+
+			for (const uint a : lhs.at(b))
+			{
+				myRowBase.push_back(myRows.size());
+				const PairRelationship * ab = relaMat.at(a).at(b);
+
+				for (const uint d : rhs.at(c))
+				{
+					const bool hit = stretchCollides(ab,
+					                                 bc,
+					                                 relaMat.at(c).at(d),
+					                                 radii.at(a) + radii.at(d));
+					myRows.push_back(hit);
+					myExcludedCount += hit;
+				}
+			}
+		}
+	}
+}
+
+bool
+ExclusionTable::excluded(const uint a,
+                         const uint b,
+                         const uint c,
+                         const uint d)
+{
+	return rhsRow(a, b, c)[myRhsPos[c * myDim + d]];
+}
+
+const char *
+ExclusionTable::rhsRow(const uint a, const uint b, const uint c)
+{
+	const int pair = myPairs[b * myDim + c];
+	const uint triple = myTripleBase[pair] + myLhsPos[b * myDim + a];
+	return &myRows[myRowBase[triple]];
+}
+
+ulong
+ExclusionTable::excludedCount()
+{
+	return myExcludedCount;
+}
+
+ulong
+ExclusionTable::size()
+{
+	return myRows.size();
+}
+
+int _testExclusionTable()
+{
+	using namespace elfin;
+
+	msg("Testing ExclusionTable\n");
+
+	uint failCount = 0;
+
+	RelaMat relaMat;
+	NameIdMap nameIdMap;
+	IdNameMap idNameMap;
+	RadiiList radiiList;
+	JSONParser().parseDB("../../res/xDB.json", nameIdMap, idNameMap, relaMat, radiiList);
+
+	const uint dim = radiiList.size();
+	std::vector<float> radii;
+	for (const auto & r : radiiList)
+		radii.push_back(measureRadius<MaxHeavy>(r));
+
+	ExclusionTable::setup(relaMat, radii);
+
+	if (ExclusionTable::excludedCount() == 0 ||
+	        ExclusionTable::excludedCount() == ExclusionTable::size())
+	{
+		failCount++;
+		err("%lu of %lu stretches excluded\n",
+		    ExclusionTable::excludedCount(), ExclusionTable::size());
+	}
+
+	// Every stretch against placing it the other way round,
+	// from d towards a as reverse growth does. Pairs within
+	// rounding of touching may go either way
+	ulong stretches = 0, mismatches = 0;
+	for (uint a = 0; a < dim; a++)
+	for (uint b = 0; b < dim; b++)
+	{
+		const PairRelationship * ab = relaMat.at(a).at(b);
+		if (ab == NULL)
+			continue;
+
+		for (uint c = 0; c < dim; c++)
+		{
+			const PairRelationship * bc = relaMat.at(b).at(c);
+			if (bc == NULL)
+				continue;
+
+			const char * row = ExclusionTable::rhsRow(a, b, c);
+			uint j = 0;
+			for (uint d = 0; d < dim; d++)
+			{
+				const PairRelationship * cd = relaMat.at(c).at(d);
+				if (cd == NULL)
+					continue;
+
+				const RigidTransform toC(cd->rot, cd->tran);
+				const RigidTransform toB = RigidTransform(bc->rot, bc->tran).then(toC);
+				const float dist = toB.apply(ab->tran).distTo(Point3f(0, 0, 0));
+				const float reach = radii.at(a) + radii.at(d);
+
+				const bool table = ExclusionTable::excluded(a, b, c, d);
+				if (table != (bool) row[j++])
+				{
+					failCount++;
+					err("rhsRow() and excluded() disagree on %u %u %u %u\n", a, b, c, d);
+				}
+
+				if (table != (dist < reach) &&
+				        !float_approximates_err(dist, reach, 1e-3 * reach))
+					mismatches++;
+				stretches++;
+			}
+		}
+	}
+
+	if (mismatches > 0)
+	{
+		failCount++;
+		err("ExclusionTable wrong on %lu of %lu stretches\n", mismatches, stretches);
+	}
+
+	if (stretches != ExclusionTable::size())
+	{
+		failCount++;
+		err("ExclusionTable holds %lu stretches but the database has %lu\n",
+		    ExclusionTable::size(), stretches);
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+} // namespace elfin
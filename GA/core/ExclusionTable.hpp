@@ -0,0 +1,63 @@
+#ifndef _EXCLUSIONTABLE_HPP_
+#define _EXCLUSIONTABLE_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+
+namespace elfin
+{
+
+/*
+ * Collisions between genes three apart, by node IDs. Genes
+ * one and two apart are never tested, and every
+ * PairRelationship is a fixed transform, so whether the ends
+ * of a stretch a, b, c, d collide depends on nothing but the
+ * four IDs. setup() places every such stretch once; synthesis,
+ * growth and mutation look these pairs up instead of testing
+ * them, and start their geometric scans a gene further back.
+ *
+ * Verdicts are the test CollisionGrid makes, with d placed in
+ * the frame of a. The table is authoritative: a chain placed
+ * in another frame can round the other way on a pair that
+ * only just touches, and every caller follows the table.
+ */
+class ExclusionTable
+{
+public:
+	// radii must hold the collision radius of every node
+	// under the measure in use, e.g. CollisionGrid::nodeRadii()
+	static void setup(const RelaMat & relaMat,
+	                  const std::vector<float> & radii);
+
+	// Whether d collides with a; a-b, b-c and c-d must all be
+	// pairs in the database
+	static bool excluded(const uint a,
+	                     const uint b,
+	                     const uint c,
+	                     const uint d);
+
+	// Entry j is set if the j-th RHS neighbour of c, in
+	// ascending ID order, collides with a
+	static const char * rhsRow(const uint a, const uint b, const uint c);
+
+	// Stretches set in the table, out of all of them
+	static ulong excludedCount();
+	static ulong size();
+
+private:
+	static uint myDim;
+	static std::vector<int> myPairs;   // a * myDim + b -> pair index
+	static std::vector<uint> myLhsPos; // b * myDim + a -> a among LHS of b
+	static std::vector<uint> myRhsPos; // c * myDim + d -> d among RHS of c
+	static std::vector<uint> myTripleBase; // By pair (b, c)
+	static std::vector<uint> myRowBase;    // By triple (a, b, c)
+	static std::vector<char> myRows;
+	static ulong myExcludedCount;
+};
+
+int _testExclusionTable();
+
+} // namespace elfin
+
+#endif /* include guard */
@@ -2,11 +2,14 @@
 // protocol of the Rosetta software suite, TMalign.cc
 
 #include <cmath>
+#include <algorithm>
 
 #include "Kabsch.hpp"
 #include "util.h"
 #include "MathUtils.hpp"
 #include "../input/JSONParser.hpp"
+#include "BenchUtils.hpp"
+#include "WindowedKabsch.hpp"
 
 namespace elfin
 {
@@ -36,65 +39,48 @@ points3fToVectors(Points3f const & pts)
 	return out;
 }
 
+/*
+ * Resample pts to ref.size() points using the arc length
+ * proportions of ref. Output goes into out, whose capacity
+ * is reused so steady state scoring does not allocate.
+ */
+void
+resample(
+    const Points3f & ref,
+    const Points3f & pts,
+    Points3f & out)
+{
+	ScoringScratch & scratch = getScoringScratch();
+	scratch.refIndex.build(ref);
+	scratch.mobileIndex.build(pts);
+	scratch.mobileIndex.resample(scratch.refIndex.proportions(), out);
+}
+
 void
 resample(
     Points3f & ref,
     Points3f & pts)
 {
-	const uint N = ref.size();
-
-	// Compute  shape total lengths
-	float refTotLen = 0.0f;
-	for (int i = 1; i < N; i++)
-		refTotLen += ref.at(i).distTo(ref.at(i - 1));
-
-	float ptsTotLen = 0.0f;
-	for (int i = 1; i < pts.size(); i++)
-		ptsTotLen += pts.at(i).distTo(pts.at(i - 1));
-
-	// Upsample pts
 	Points3f resampled;
-
-	// First and last points are the same
-	resampled.push_back(pts.at(0));
-
-	float refProp = 0.0f, ptsProp = 0.0f;
-	int mpi = 1;
-	for (int i = 1; i < pts.size(); i++)
-	{
-		const Point3f & baseFpPoint = pts.at(i - 1);
-		const Point3f & nextFpPoint = pts.at(i);
-		const float baseFpProportion = ptsProp;
-		const float fpSegment = nextFpPoint.distTo(baseFpPoint)
-		                        / ptsTotLen;
-		const Vector3f vec = nextFpPoint - baseFpPoint;
-
-		ptsProp += fpSegment;
-		while (refProp <= ptsProp && mpi < N)
-		{
-			const float mpSegment =
-			    ref.at(mpi).distTo(ref.at(mpi - 1))
-			    / refTotLen;
-
-			if (refProp + mpSegment > ptsProp)
-				break;
-			refProp += mpSegment;
-
-			const float s = (refProp - baseFpProportion)
-			                / fpSegment;
-			resampled.push_back(baseFpPoint + (vec * s));
-
-			mpi++;
-		}
-	}
-
-	// Sometimes the last node is automatically added
-	if (resampled.size() < N)
-		resampled.push_back(pts.back());
-
+	resample(ref, pts, resampled);
 	pts = resampled;
 }
 
+/*
+ * Same as resample() above but reads the spec's arc length
+ * table from ctx instead of re-measuring the spec
+ */
+void
+resample(
+    const SpecScoringContext & ctx,
+    const Points3f & pts,
+    Points3f & out)
+{
+	ArcLengthIndex & mobileIndex = getScoringScratch().mobileIndex;
+	mobileIndex.build(pts);
+	mobileIndex.resample(ctx.arcProportions(), out);
+}
+
 // void
 // upsample(
 //     Points3f & ref,
@@ -464,6 +450,260 @@ bool RosettaKabsch(
 	return true;
 }
 
+// The mode=0 tail of RosettaKabsch(): rms from e0 and the
+// covariance matrix r. Operations are kept in the same order
+// so that batched scores match kabschScore() bit for bit
+static inline double
+rosettaKabschRms(
+    const double e0,
+    const double r[3][3])
+{
+	const double sqrt3 = 1.73205080756888;
+	double e[3], rr[6];
+
+	double det = r[0][0] * ( r[1][1] * r[2][2] - r[1][2] * r[2][1] )\
+	             - r[0][1] * ( r[1][0] * r[2][2] - r[1][2] * r[2][0] )\
+	             + r[0][2] * ( r[1][0] * r[2][1] - r[1][1] * r[2][0] );
+	const double sigma = det;
+
+	int m = 0;
+	for (int j = 0; j < 3; j++) {
+		for (int i = 0; i <= j; i++) {
+			rr[m] = r[0][i] * r[0][j] + r[1][i] * r[1][j] + r[2][i] * r[2][j];
+			m++;
+		}
+	}
+
+	const double spur = (rr[0] + rr[2] + rr[5]) / 3.0;
+	const double cof = (((((rr[2] * rr[5] - rr[4] * rr[4]) + rr[0] * rr[5])\
+	                      - rr[3] * rr[3]) + rr[0] * rr[2]) - rr[1] * rr[1]) / 3.0;
+	det = det * det;
+
+	for (int i = 0; i < 3; i++)
+		e[i] = spur;
+
+	if (spur > 0) {
+		double d = spur * spur;
+		const double h = d - cof;
+		const double g = (spur * cof - det) / 2.0 - spur * h;
+
+		if (h > 0) {
+			const double sqrth = sqrt(h);
+			d = h * h * h - g * g;
+			if (d < 0.0) d = 0.0;
+			d = atan2(sqrt(d), -g) / 3.0;
+			const double cth = sqrth * cos(d);
+			const double sth = sqrth * sqrt3 * sin(d);
+			e[0] = (spur + cth) + cth;
+			e[1] = (spur - cth) + sth;
+			e[2] = (spur - cth) - sth;
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (e[i] < 0) e[i] = 0;
+		e[i] = sqrt(e[i]);
+	}
+	double d = e[2];
+	if (sigma < 0.0)
+		d = -d;
+	d = (d + e[1]) + e[0];
+
+	double rms = (e0 - d) - d;
+	if (rms < 0.0) rms = 0.0;
+
+	return rms;
+}
+
+/*
+ * Theobald's QCP method (Acta Cryst. A61:478, 2005; with the
+ * coefficient layout of Liu et al., J Comput Chem 31:1561,
+ * 2010). The largest eigenvalue of the 4x4 key matrix is the
+ * maximum of sum(y . Ux) over rotations U; it is found by
+ * Newton iteration on the characteristic polynomial, so no
+ * rotation is ever formed. Returns the same quantity as
+ * rosettaKabschRms(): e0 - 2 * lambda_max, clamped at 0.
+ */
+static inline double
+qcpRms(
+    const double e0,
+    const double r[3][3])
+{
+	const double evalPrec = 1e-11;
+	const int maxIters = 50;
+
+	const double Sxx = r[0][0], Sxy = r[0][1], Sxz = r[0][2];
+	const double Syx = r[1][0], Syy = r[1][1], Syz = r[1][2];
+	const double Szx = r[2][0], Szy = r[2][1], Szz = r[2][2];
+
+	const double Sxx2 = Sxx * Sxx, Syy2 = Syy * Syy, Szz2 = Szz * Szz;
+	const double Sxy2 = Sxy * Sxy, Syz2 = Syz * Syz, Sxz2 = Sxz * Sxz;
+	const double Syx2 = Syx * Syx, Szy2 = Szy * Szy, Szx2 = Szx * Szx;
+
+	const double SyzSzymSyySzz2 = 2.0 * (Syz * Szy - Syy * Szz);
+	const double Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+
+	const double C2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + Syz2 + Szy2);
+	const double C1 = 8.0 * (Sxx * Syz * Szy + Syy * Szx * Sxz + Szz * Sxy * Syx -
+	                         Sxx * Syy * Szz - Syz * Szx * Sxy - Szy * Syx * Sxz);
+
+	const double SxzpSzx = Sxz + Szx;
+	const double SyzpSzy = Syz + Szy;
+	const double SxypSyx = Sxy + Syx;
+	const double SyzmSzy = Syz - Szy;
+	const double SxzmSzx = Sxz - Szx;
+	const double SxymSyx = Sxy - Syx;
+	const double SxxpSyy = Sxx + Syy;
+	const double SxxmSyy = Sxx - Syy;
+	const double Sxy2Sxz2Syx2Szx2 = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+	const double C0 =
+	    Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2
+	    + (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) * (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2)
+	    + (-(SxzpSzx) * (SyzmSzy) + (SxymSyx) * (SxxmSyy - Szz)) * (-(SxzmSzx) * (SyzpSzy) + (SxymSyx) * (SxxmSyy + Szz))
+	    + (-(SxzpSzx) * (SyzpSzy) - (SxypSyx) * (SxxpSyy - Szz)) * (-(SxzmSzx) * (SyzmSzy) - (SxypSyx) * (SxxpSyy + Szz))
+	    + (+(SxypSyx) * (SyzpSzy) + (SxzpSzx) * (SxxmSyy + Szz)) * (-(SxymSyx) * (SyzmSzy) + (SxzpSzx) * (SxxpSyy + Szz))
+	    + (+(SxypSyx) * (SyzmSzy) + (SxzmSzx) * (SxxmSyy - Szz)) * (-(SxymSyx) * (SyzpSzy) + (SxzmSzx) * (SxxpSyy - Szz));
+
+	// lambda_max <= e0 / 2, so start there and walk down
+	double lambda = e0 / 2.0;
+	for (int i = 0; i < maxIters; i++)
+	{
+		const double old = lambda;
+		const double x2 = lambda * lambda;
+		const double b = (x2 + C2) * lambda;
+		const double a = b + C1;
+		const double denom = 2.0 * x2 * lambda + b + a;
+		if (denom == 0.0)
+			break;
+		lambda -= (a * lambda + C0) / denom;
+		if (fabs(lambda - old) < fabs(evalPrec * lambda))
+			break;
+	}
+
+	double rms = e0 - 2.0 * lambda;
+	if (rms < 0.0) rms = 0.0;
+
+	return rms;
+}
+
+/*
+ * Allocation-free equivalent of Kabsch(..., mode=0): reads
+ * the points directly instead of converting them to
+ * Matrix<double> first
+ */
+static double
+kabschRms(
+    const Points3f & mobile,
+    const Points3f & ref)
+{
+	const size_t n = mobile.size();
+	double xc[3] = {0.0, 0.0, 0.0}, yc[3] = {0.0, 0.0, 0.0};
+	double r[3][3] = {{0.0}};
+	double e0 = 0.0;
+
+	panic_if(n < 1, "Kabsch failed!\n");
+
+	for (int m = 0; m < n; m++)
+	{
+		xc[0] += mobile[m].x;
+		xc[1] += mobile[m].y;
+		xc[2] += mobile[m].z;
+
+		yc[0] += ref[m].x;
+		yc[1] += ref[m].y;
+		yc[2] += ref[m].z;
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		xc[i] = xc[i] / n;
+		yc[i] = yc[i] / n;
+	}
+
+	for (int m = 0; m < n; m++)
+	{
+		const double x[3] = {mobile[m].x, mobile[m].y, mobile[m].z};
+		const double y[3] = {ref[m].x, ref[m].y, ref[m].z};
+		for (int i = 0; i < 3; i++)
+		{
+			e0 += (x[i] - xc[i]) * (x[i] - xc[i]) + \
+			      (y[i] - yc[i]) * (y[i] - yc[i]);
+			const double d = y[i] - yc[i];
+			for (int j = 0; j < 3; j++)
+				r[i][j] += d * (x[j] - xc[j]);
+		}
+	}
+
+	return rosettaKabschRms(e0, r);
+}
+
+// Kabsch statistics against a precomputed spec: only the
+// mobile shape's centre and terms are computed here
+static void
+kabschStats(
+    const Points3f & mobile,
+    const SpecScoringContext & ctx,
+    double & e0,
+    double r[3][3])
+{
+	const size_t n = mobile.size();
+	const double * yx = ctx.centredX().data();
+	const double * yy = ctx.centredY().data();
+	const double * yz = ctx.centredZ().data();
+	double xc[3] = {0.0, 0.0, 0.0};
+
+	panic_if(n != ctx.size() || n < 1, "Kabsch failed!\n");
+
+	e0 = ctx.sqNormSum();
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			r[i][j] = 0.0;
+
+	for (int m = 0; m < n; m++)
+	{
+		xc[0] += mobile[m].x;
+		xc[1] += mobile[m].y;
+		xc[2] += mobile[m].z;
+	}
+	for (int i = 0; i < 3; i++)
+		xc[i] = xc[i] / n;
+
+	for (int m = 0; m < n; m++)
+	{
+		const double x[3] = {
+			mobile[m].x - xc[0],
+			mobile[m].y - xc[1],
+			mobile[m].z - xc[2]
+		};
+		const double d[3] = {yx[m], yy[m], yz[m]};
+		for (int i = 0; i < 3; i++)
+		{
+			e0 += x[i] * x[i];
+			for (int j = 0; j < 3; j++)
+				r[i][j] += d[i] * x[j];
+		}
+	}
+}
+
+double
+solveKabschRms(
+    const ScoreBackend backend,
+    const double e0,
+    const double r[3][3])
+{
+	switch (backend)
+	{
+	case ScoreBackend::Rosetta:
+		return rosettaKabschRms(e0, r);
+	case ScoreBackend::QCP:
+		return qcpRms(e0, r);
+	default:
+		die("Unknown score backend %d\n", backend);
+	}
+
+	return NAN;
+}
+
 // A Wrapper to call the a bit more complicated Rosetta version
 bool Kabsch(
     const Points3f & mobile,
@@ -492,13 +732,40 @@ bool Kabsch(
 	return retVal;
 }
 
+void
+ScoringScratch::reserve(const uint maxLen, const uint refLen)
+{
+	mobile.reserve(maxLen);
+	resampled.reserve(refLen);
+	mobileIndex.reserve(maxLen);
+	refIndex.reserve(refLen);
+	batch.resize(refLen, KABSCH_BATCH_LANES);
+	windowPrefix.reserve((refLen + 1) * WINDOW_PREFIX_TERMS);
+}
+
+ScoringScratch &
+getScoringScratch()
+{
+	static thread_local ScoringScratch scratch;
+	return scratch;
+}
+
+void
+setupScoringScratch(const uint maxLen, const uint refLen)
+{
+	#pragma omp parallel
+	{
+		getScoringScratch().reserve(maxLen, refLen);
+	}
+}
+
 float
 kabschScore(
     const Genes & genes,
-    Points3f ref)
+    const Points3f & ref)
 {
 	// First make a copy of genes into points
-	Points3f mobile;
+	Points3f & mobile = getScoringScratch().mobile;
 	mobile.resize(genes.size());
 
 	for (int i = 0; i < genes.size(); i++)
@@ -512,22 +779,415 @@ kabschScore(
 
 float
 kabschScore(
-    Points3f mobile,
-    Points3f ref)
+    const Points3f & mobile,
+    const Points3f & ref)
 {
 	if (ref.size() != mobile.size())
-		resample(ref, mobile);
+	{
+		Points3f & resampled = getScoringScratch().resampled;
+		resample(ref, mobile, resampled);
+		return kabschRms(resampled, ref);
+	}
 
-	// Run Kabsch to get RMS
-	Matrix<double> rot;
-	Vector3f tran;
-	double rms;
+	return kabschRms(mobile, ref);
+}
 
-	const bool retVal = Kabsch(mobile, ref, rot, tran, rms, 0);
+float
+kabschScore(
+    const Genes & genes,
+    const SpecScoringContext & ctx,
+    const ScoreBackend backend)
+{
+	ScoringScratch & scratch = getScoringScratch();
+	Points3f & mobile = scratch.mobile;
+	mobile.resize(genes.size());
 
-	panic_if(!retVal, "Kabsch failed!\n");
+	for (int i = 0; i < genes.size(); i++)
+		mobile.at(i) = genes.at(i).com();
 
-	return rms;
+	double e0, r[3][3];
+	if (ctx.needsResample(mobile.size()))
+	{
+		resample(ctx, mobile, scratch.resampled);
+		kabschStats(scratch.resampled, ctx, e0, r);
+	}
+	else
+	{
+		kabschStats(mobile, ctx, e0, r);
+	}
+
+	return solveKabschRms(backend, e0, r);
+}
+
+KabschBatch::KabschBatch(const uint n, const uint count)
+{
+	resize(n, count);
+}
+
+void
+KabschBatch::resize(const uint n, const uint count)
+{
+	myN = n;
+	myCount = count;
+
+	// Lanes past count() in the last group hold zeros, or
+	// stale shapes once the batch is reused; they score
+	// harmlessly and are never read back
+	const size_t len = (size_t) groups() * n * KABSCH_BATCH_LANES;
+	myXs.assign(len, 0.0f);
+	myYs.assign(len, 0.0f);
+	myZs.assign(len, 0.0f);
+}
+
+void
+KabschBatch::load(const uint index, const Points3f & pts)
+{
+	panic_if(index >= myCount,
+	         "KabschBatch::load(): index %u out of %u\n", index, myCount);
+	panic_if(pts.size() != myN,
+	         "KabschBatch::load(): expected %u points but got %lu\n",
+	         myN, pts.size());
+
+	const uint group = index / KABSCH_BATCH_LANES;
+	const uint lane = index % KABSCH_BATCH_LANES;
+	size_t offset = (size_t) group * myN * KABSCH_BATCH_LANES + lane;
+	for (int m = 0; m < myN; m++)
+	{
+		const Point3f & pt = pts.at(m);
+		myXs[offset] = pt.x;
+		myYs[offset] = pt.y;
+		myZs[offset] = pt.z;
+		offset += KABSCH_BATCH_LANES;
+	}
+}
+
+void
+KabschBatch::load(
+    const uint index,
+    const Genes & genes,
+    const SpecScoringContext & ctx)
+{
+	ScoringScratch & scratch = getScoringScratch();
+	Points3f & mobile = scratch.mobile;
+	mobile.resize(genes.size());
+
+	for (int i = 0; i < genes.size(); i++)
+		mobile.at(i) = genes.at(i).com();
+
+	if (ctx.needsResample(mobile.size()))
+	{
+		resample(ctx, mobile, scratch.resampled);
+		load(index, scratch.resampled);
+	}
+	else
+	{
+		load(index, mobile);
+	}
+}
+
+uint
+KabschBatch::n() const
+{
+	return myN;
+}
+
+uint
+KabschBatch::count() const
+{
+	return myCount;
+}
+
+uint
+KabschBatch::groups() const
+{
+	return (myCount + KABSCH_BATCH_LANES - 1) / KABSCH_BATCH_LANES;
+}
+
+const float *
+KabschBatch::xs() const
+{
+	return myXs.data();
+}
+
+const float *
+KabschBatch::ys() const
+{
+	return myYs.data();
+}
+
+const float *
+KabschBatch::zs() const
+{
+	return myZs.data();
+}
+
+typedef double (*RmsSolver)(const double e0, const double r[3][3]);
+
+/*
+ * Summation policies for the batched kernel. Each lane keeps
+ * its own compensation term and vectorisation runs across
+ * lanes, so no sum is ever reassociated and Kahan's
+ * correction survives -O3.
+ */
+template <typename T>
+struct PlainSum
+{
+	static inline void add(T & sum, T & /* comp */, const T v)
+	{
+		sum += v;
+	}
+};
+
+struct KahanSum
+{
+	static inline void add(float & sum, float & comp, const float v)
+	{
+		const float y = v - comp;
+		const float t = sum + y;
+		comp = (t - sum) - y;
+		sum = t;
+	}
+};
+
+template <typename T>
+static const T * specAxis(const SpecScoringContext & ctx, const int axis);
+
+template <>
+const double *
+specAxis<double>(const SpecScoringContext & ctx, const int axis)
+{
+	return axis == 0 ? ctx.centredX().data() :
+	       axis == 1 ? ctx.centredY().data() : ctx.centredZ().data();
+}
+
+template <>
+const float *
+specAxis<float>(const SpecScoringContext & ctx, const int axis)
+{
+	return axis == 0 ? ctx.centredXf().data() :
+	       axis == 1 ? ctx.centredYf().data() : ctx.centredZf().data();
+}
+
+/*
+ * Scores every shape in mobiles against the spec in ctx.
+ * Centres, e0 and covariance are accumulated across the
+ * lanes of a group so the compiler can keep one shape per
+ * SIMD lane; the 3x3 eigen-solve then runs lane by lane.
+ * The solver is a template argument so that the backend is
+ * picked once per batch, not once per shape.
+ *
+ * Accumulation is in T using the Sum policy; float halves
+ * the width of every SIMD op. Only the eigen-solve, where
+ * cancellation happens, runs in double.
+ */
+template <RmsSolver solve, typename T, typename Sum>
+static void
+kabschScoreBatchWith(
+    const KabschBatch & mobiles,
+    const SpecScoringContext & ctx,
+    float * scoresOut)
+{
+	const uint n = mobiles.n();
+	const uint L = KABSCH_BATCH_LANES;
+
+	panic_if(ctx.size() != n,
+	         "kabschScoreBatch(): batch has %u points but spec has %u\n",
+	         n, ctx.size());
+
+	if (n < 1)
+		die("kabschScoreBatch(): empty shapes\n");
+
+	// Centred spec is shared by all lanes
+	const T * yx = specAxis<T>(ctx, 0);
+	const T * yy = specAxis<T>(ctx, 1);
+	const T * yz = specAxis<T>(ctx, 2);
+
+	for (int g = 0; g < mobiles.groups(); g++)
+	{
+		const size_t base = (size_t) g * n * L;
+		const float * xyz[3] = {
+			mobiles.xs() + base,
+			mobiles.ys() + base,
+			mobiles.zs() + base
+		};
+
+		T xc[3][L], xcComp[3][L];
+		T e0[L], e0Comp[L];
+		T r[3][3][L], rComp[3][3][L];
+
+		// The spec's part of e0 is large next to a score, so it
+		// is added in double after accumulation
+		for (int l = 0; l < L; l++)
+		{
+			e0[l] = e0Comp[l] = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				xc[i][l] = xcComp[i][l] = 0;
+				for (int j = 0; j < 3; j++)
+					r[i][j][l] = rComp[i][j][l] = 0;
+			}
+		}
+
+		// Centres
+		for (int m = 0; m < n; m++)
+			for (int i = 0; i < 3; i++)
+			{
+				const float * row = xyz[i] + m * L;
+				#pragma omp simd
+				for (int l = 0; l < L; l++)
+					Sum::add(xc[i][l], xcComp[i][l], (T) row[l]);
+			}
+
+		for (int i = 0; i < 3; i++)
+			#pragma omp simd
+			for (int l = 0; l < L; l++)
+				xc[i][l] = xc[i][l] / n;
+
+		// e0 and covariance matrix r
+		for (int m = 0; m < n; m++)
+		{
+			const T d[3] = {yx[m], yy[m], yz[m]};
+			for (int i = 0; i < 3; i++)
+			{
+				const float * xi = xyz[i] + m * L;
+				#pragma omp simd
+				for (int l = 0; l < L; l++)
+				{
+					const T dx = (T) xi[l] - xc[i][l];
+					Sum::add(e0[l], e0Comp[l], dx * dx);
+				}
+
+				for (int j = 0; j < 3; j++)
+				{
+					const float * xj = xyz[j] + m * L;
+					#pragma omp simd
+					for (int l = 0; l < L; l++)
+						Sum::add(r[i][j][l], rComp[i][j][l],
+						         d[i] * ((T) xj[l] - xc[j][l]));
+				}
+			}
+		}
+
+		// Eigen-solve and rms per lane
+		const uint lanesUsed = std::min(L, mobiles.count() - g * L);
+		for (int l = 0; l < lanesUsed; l++)
+		{
+			const double rl[3][3] = {
+				{r[0][0][l], r[0][1][l], r[0][2][l]},
+				{r[1][0][l], r[1][1][l], r[1][2][l]},
+				{r[2][0][l], r[2][1][l], r[2][2][l]}
+			};
+			scoresOut[g * L + l] = solve(ctx.sqNormSum() + e0[l], rl);
+		}
+	}
+}
+
+template <RmsSolver solve>
+static void
+kabschScoreBatchIn(
+    const KabschBatch & mobiles,
+    const SpecScoringContext & ctx,
+    float * scoresOut,
+    const ScorePrecision precision)
+{
+	switch (precision)
+	{
+	case ScorePrecision::Double:
+		kabschScoreBatchWith<solve, double, PlainSum<double>>(mobiles, ctx, scoresOut);
+		break;
+	case ScorePrecision::Float:
+		kabschScoreBatchWith<solve, float, PlainSum<float>>(mobiles, ctx, scoresOut);
+		break;
+	case ScorePrecision::Kahan:
+		kabschScoreBatchWith<solve, float, KahanSum>(mobiles, ctx, scoresOut);
+		break;
+	default:
+		die("Unknown score precision %d\n", precision);
+	}
+}
+
+void
+kabschScoreBatch(
+    const KabschBatch & mobiles,
+    const SpecScoringContext & ctx,
+    float * scoresOut,
+    const ScoreBackend backend,
+    const ScorePrecision precision)
+{
+	switch (backend)
+	{
+	case ScoreBackend::Rosetta:
+		kabschScoreBatchIn<rosettaKabschRms>(mobiles, ctx, scoresOut, precision);
+		break;
+	case ScoreBackend::QCP:
+		kabschScoreBatchIn<qcpRms>(mobiles, ctx, scoresOut, precision);
+		break;
+	default:
+		die("Unknown score backend %d\n", backend);
+	}
+}
+
+/*
+ * Admissible lower bound on the Kabsch score, from two
+ * facts that hold for any rotation U of centred shapes x
+ * and y:
+ *
+ *   sum(y . Ux) <= |x| |y| (Cauchy-Schwarz), so
+ *       score >= (|x| - |y|)^2, the radius of gyration bound
+ *   the first and last residuals differ by at least the
+ *       difference of end-to-end distances, so
+ *       score >= (|x_n - x_1| - |y_n - y_1|)^2 / 2
+ *
+ * Both cost one pass over the lane with no eigen-solve.
+ */
+float
+kabschLowerBound(
+    const KabschBatch & mobiles,
+    const uint index,
+    const SpecScoringContext & ctx)
+{
+	const uint n = mobiles.n();
+	const uint L = KABSCH_BATCH_LANES;
+
+	panic_if(index >= mobiles.count(),
+	         "kabschLowerBound(): index %u out of %u\n", index, mobiles.count());
+
+	const size_t base = (size_t) (index / L) * n * L + index % L;
+	const float * xyz[3] = {
+		mobiles.xs() + base,
+		mobiles.ys() + base,
+		mobiles.zs() + base
+	};
+
+	double xc[3] = {0.0, 0.0, 0.0};
+	for (int m = 0; m < n; m++)
+		for (int i = 0; i < 3; i++)
+			xc[i] += xyz[i][m * L];
+
+	for (int i = 0; i < 3; i++)
+		xc[i] = xc[i] / n;
+
+	double sqNormSum = 0.0;
+	double endToEndSq = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int m = 0; m < n; m++)
+		{
+			const double d = xyz[i][m * L] - xc[i];
+			sqNormSum += d * d;
+		}
+
+		const double e = xyz[i][(n - 1) * L] - xyz[i][0];
+		endToEndSq += e * e;
+	}
+
+	const double gyration = sqrt(sqNormSum) - sqrt(ctx.sqNormSum());
+	const double endToEnd = sqrt(endToEndSq) - ctx.endToEnd();
+	const double bound = std::max(gyration * gyration,
+	                              endToEnd * endToEnd / 2.0);
+
+	// Stay under the computed score despite its rounding
+	return (float) (bound * (1.0 - 1e-5));
 }
 
 int _testKabsch()
@@ -573,6 +1233,13 @@ int _testKabsch()
 	                          5.08395199432057,
 	                          -13.0170407784248);
 
+	Vector3f rotRows[3] = {
+		Vector3f(1.0f, 0.0f, 0.0f),
+		Vector3f(0.0f, -0.5177697998f, 0.855519979f),
+		Vector3f(0.0f, -0.855519979f, -0.5177697998f)
+	};
+	const Mat3x3 rotAroundX(rotRows);
+
 	Points3f A(arrA, arrA + sizeof(arrA) / sizeof(arrA[0]));
 	Points3f B(arrB, arrB + sizeof(arrB) / sizeof(arrB[0]));
 
@@ -701,6 +1368,221 @@ int _testKabsch()
 		failCount++;
 	}
 
+	// Test batched scoring against one-by-one scoring; use
+	// a count that leaves the last lane group partly empty
+	{
+		std::vector<Genes> shapes;
+
+		Genes shape;
+		for (int i = 0; i < A.size(); i++)
+			shape.push_back(Gene(i, A.at(i)));
+		shapes.push_back(shape);
+
+		shape.clear();
+		for (int i = 0; i < B.size(); i++)
+			shape.push_back(Gene(i, B.at(i) + Vector3f(-10, 20, 30)));
+		shapes.push_back(shape);
+
+		shape.clear();
+		for (int i = 0; i < B.size(); i++)
+			if (i != B.size() / 2)
+				shape.push_back(Gene(i, B.at(i)));
+		shapes.push_back(shape);
+
+		shape.clear();
+		for (int i = 0; i < A.size(); i++)
+			if (i % 3 != 1)
+				shape.push_back(Gene(i, A.at(i).dot(rotAroundX)));
+		shapes.push_back(shape);
+
+		const SpecScoringContext ctx(B, 0, 2 * B.size());
+		const uint count = 2 * KABSCH_BATCH_LANES + 3;
+		KabschBatch batch(B.size(), count);
+		for (int i = 0; i < count; i++)
+			batch.load(i, shapes.at(i % shapes.size()), ctx);
+
+		std::vector<float> batchScores(count);
+		kabschScoreBatch(batch, ctx, batchScores.data());
+
+		for (int i = 0; i < count; i++)
+		{
+			const Genes & shape = shapes.at(i % shapes.size());
+			const float expected = kabschScore(shape, B);
+			if (!float_approximates_err(batchScores.at(i), expected, 1e-5 * (1 + expected)))
+			{
+				failCount++;
+				err("Batch score #%d differs: %.10f vs %.10f\n",
+				    i, batchScores.at(i), expected);
+			}
+
+			const float ctxScore = kabschScore(shape, ctx);
+			if (!float_approximates_err(ctxScore, expected, 1e-5 * (1 + expected)))
+			{
+				failCount++;
+				err("Spec context score #%d differs: %.10f vs %.10f\n",
+				    i, ctxScore, expected);
+			}
+		}
+
+		// QCP solves the same problem by a different route,
+		// so it only has to agree within tolerance
+		std::vector<float> qcpScores(count);
+		kabschScoreBatch(batch, ctx, qcpScores.data(), ScoreBackend::QCP);
+
+		for (int i = 0; i < count; i++)
+		{
+			const float expected = batchScores.at(i);
+			if (!float_approximates_err(qcpScores.at(i), expected, 1e-4 * (1 + expected)))
+			{
+				failCount++;
+				err("QCP score #%d differs: %.10f vs %.10f\n",
+				    i, qcpScores.at(i), expected);
+			}
+
+			const Genes & shape = shapes.at(i % shapes.size());
+			const float single = kabschScore(shape, ctx, ScoreBackend::QCP);
+			if (!float_approximates_err(single, qcpScores.at(i), 1e-5 * (1 + expected)))
+			{
+				failCount++;
+				err("QCP single score #%d differs from batch: %.10f vs %.10f\n",
+				    i, single, qcpScores.at(i));
+			}
+		}
+
+		if (!float_approximates(batchScores.at(0), 7796.9331054688) ||
+		        !float_approximates(batchScores.at(2), 650.2928466797))
+		{
+			failCount++;
+			err("Batch scores do not match known scores\n");
+		}
+
+		// Float accumulation must stay close to the known
+		// scores, with or without Kahan compensation
+		const ScorePrecision lowPrecisions[] = {
+			ScorePrecision::Float, ScorePrecision::Kahan
+		};
+		for (const ScorePrecision precision : lowPrecisions)
+		{
+			std::vector<float> lowScores(count);
+			kabschScoreBatch(batch, ctx, lowScores.data(),
+			                 ScoreBackend::Rosetta, precision);
+
+			const double errA = fabs(lowScores.at(0) - 7796.9331054688) / 7796.9331054688;
+			const double errB = fabs(lowScores.at(2) - 650.2928466797) / 650.2928466797;
+			msg("%s precision: %.6f (rel err %.2e), %.6f (rel err %.2e)\n",
+			    ScorePrecisionString[precision],
+			    lowScores.at(0), errA, lowScores.at(2), errB);
+			if (errA > 1e-5 || errB > 1e-4)
+			{
+				failCount++;
+				err("%s precision scores deviate from known scores\n",
+				    ScorePrecisionString[precision]);
+			}
+
+			for (int i = 0; i < count; i++)
+			{
+				const float expected = batchScores.at(i);
+				if (!float_approximates_err(lowScores.at(i), expected, 1e-3 * (1 + expected)))
+				{
+					failCount++;
+					err("%s precision score #%d differs: %.10f vs %.10f\n",
+					    ScorePrecisionString[precision], i, lowScores.at(i), expected);
+				}
+			}
+		}
+	}
+
+	// Test that Kahan compensation is no worse than plain
+	// float against double on the benchmark specs, where
+	// chains are long enough for summation error to show
+	{
+		const char * dirs[] = { FOREACH_BENCH_SPEC_DIR(GEN_STRING) };
+		const uint shapesPerSpec = 1 << 9;
+		uint seed = 0x600d1337;
+
+		for (const char * dir : dirs)
+		{
+			const std::vector<BenchSpec> specs = loadBenchSpecs(
+			        std::string(BENCH_SPEC_ROOT) + dir);
+
+			double floatMaxRelErr = 0.0, kahanMaxRelErr = 0.0;
+			for (const auto & spec : specs)
+			{
+				const uint n = spec.coms.size();
+				const SpecScoringContext ctx(spec.coms, n, n);
+
+				KabschBatch batch(n, shapesPerSpec);
+				for (int i = 0; i < shapesPerSpec; i++)
+					batch.load(i, jitterPoints(spec.coms, 8.0f, seed));
+
+				std::vector<float> doubleScores(shapesPerSpec);
+				std::vector<float> floatScores(shapesPerSpec);
+				std::vector<float> kahanScores(shapesPerSpec);
+				kabschScoreBatch(batch, ctx, doubleScores.data(),
+				                 ScoreBackend::QCP, ScorePrecision::Double);
+				kabschScoreBatch(batch, ctx, floatScores.data(),
+				                 ScoreBackend::QCP, ScorePrecision::Float);
+				kabschScoreBatch(batch, ctx, kahanScores.data(),
+				                 ScoreBackend::QCP, ScorePrecision::Kahan);
+
+				for (int i = 0; i < shapesPerSpec; i++)
+				{
+					const double ref = doubleScores.at(i);
+					floatMaxRelErr = std::max(floatMaxRelErr,
+					                          fabs(floatScores.at(i) - ref) / (1.0 + fabs(ref)));
+					kahanMaxRelErr = std::max(kahanMaxRelErr,
+					                          fabs(kahanScores.at(i) - ref) / (1.0 + fabs(ref)));
+				}
+			}
+
+			msg("%s: worst rel err Float %.2e, Kahan %.2e\n",
+			    dir, floatMaxRelErr, kahanMaxRelErr);
+			if (kahanMaxRelErr > floatMaxRelErr)
+			{
+				failCount++;
+				err("Kahan precision is worse than Float on %s: %.2e vs %.2e\n",
+				    dir, kahanMaxRelErr, floatMaxRelErr);
+			}
+		}
+	}
+
+	// Test that the lower bound never exceeds the score,
+	// and is tight for a rigidly moved copy of the spec
+	{
+		const SpecScoringContext ctx(B, 0, B.size());
+		const uint count = 64;
+		KabschBatch batch(B.size(), count);
+
+		uint seed = 0x1337;
+		for (int i = 0; i < count; i++)
+		{
+			Points3f shape = i == 0 ? B : jitterPoints(B, 4.0f * i, seed);
+			for (auto & p : shape)
+				p = p.dot(rotAroundX) + Vector3f(i, -2 * i, 3);
+			batch.load(i, shape);
+		}
+
+		std::vector<float> scores(count);
+		kabschScoreBatch(batch, ctx, scores.data());
+
+		for (int i = 0; i < count; i++)
+		{
+			const float bound = kabschLowerBound(batch, i, ctx);
+			if (bound > scores.at(i) || bound < 0.0f)
+			{
+				failCount++;
+				err("Lower bound #%d is not admissible: %.10f > %.10f\n",
+				    i, bound, scores.at(i));
+			}
+		}
+
+		if (!float_approximates_err(kabschLowerBound(batch, 0, ctx), 0.0f, 1e-2))
+		{
+			failCount++;
+			err("Lower bound of a rigidly moved spec should be 0\n");
+		}
+	}
+
 	// Test verdict
 	if (failCount == 0)
 		msg("Passed!\n");
@@ -710,4 +1592,126 @@ int _testKabsch()
 	return failCount;
 }
 
+int _benchKabsch()
+{
+	msg("Benchmarking Kabsch score backends and precisions\n");
+
+	const char * dirs[] = { FOREACH_BENCH_SPEC_DIR(GEN_STRING) };
+	const uint shapesPerSpec = 1 << 13;
+	const int reps = 10;
+	const float jitter = 8.0f;
+	const double tolerance = 1e-4;
+
+	// Float inputs to the covariance carry ~7 digits and the
+	// score's e0 - 2d cancellation costs about two more
+	const double mixedTolerance = 2e-3;
+
+	int failCount = 0;
+	for (const char * dir : dirs)
+	{
+		const std::vector<BenchSpec> specs = loadBenchSpecs(
+		        std::string(BENCH_SPEC_ROOT) + dir);
+		if (specs.size() == 0)
+			continue;
+
+		double rosettaTime = 0.0, qcpTime = 0.0, maxRelDiff = 0.0;
+		double floatTime = 0.0, kahanTime = 0.0;
+		double floatMaxRelErr = 0.0, kahanMaxRelErr = 0.0;
+		ulong scored = 0;
+		uint seed = 0x600d1337;
+
+		for (const auto & spec : specs)
+		{
+			const uint n = spec.coms.size();
+			const SpecScoringContext ctx(spec.coms, n, n);
+
+			KabschBatch batch(n, shapesPerSpec);
+			for (int i = 0; i < shapesPerSpec; i++)
+				batch.load(i, jitterPoints(spec.coms, jitter, seed));
+
+			std::vector<float> rosettaScores(shapesPerSpec);
+			std::vector<float> qcpScores(shapesPerSpec);
+
+			double t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				kabschScoreBatch(batch, ctx, rosettaScores.data(), ScoreBackend::Rosetta);
+			rosettaTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				kabschScoreBatch(batch, ctx, qcpScores.data(), ScoreBackend::QCP);
+			qcpTime += get_timestamp_us() - t0;
+
+			// Precisions are compared under QCP, whose solve is
+			// cheap enough for accumulation to be most of the
+			// time; Rosetta's eigen-solve hides the difference
+			std::vector<float> floatScores(shapesPerSpec);
+			std::vector<float> kahanScores(shapesPerSpec);
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				kabschScoreBatch(batch, ctx, floatScores.data(),
+				                 ScoreBackend::QCP, ScorePrecision::Float);
+			floatTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				kabschScoreBatch(batch, ctx, kahanScores.data(),
+				                 ScoreBackend::QCP, ScorePrecision::Kahan);
+			kahanTime += get_timestamp_us() - t0;
+
+			for (int i = 0; i < shapesPerSpec; i++)
+			{
+				const double ref = rosettaScores.at(i);
+				const double relDiff = fabs(qcpScores.at(i) - ref) / (1.0 + fabs(ref));
+				maxRelDiff = std::max(maxRelDiff, relDiff);
+
+				const double qcpRef = qcpScores.at(i);
+				floatMaxRelErr = std::max(floatMaxRelErr,
+				                          fabs(floatScores.at(i) - qcpRef) / (1.0 + fabs(qcpRef)));
+				kahanMaxRelErr = std::max(kahanMaxRelErr,
+				                          fabs(kahanScores.at(i) - qcpRef) / (1.0 + fabs(qcpRef)));
+			}
+
+			scored += (ulong) shapesPerSpec * reps;
+		}
+
+		msg("%s (%lu specs): Rosetta %.1fns/shape, QCP %.1fns/shape (%.2fx), max rel diff %.2e\n",
+		    dir,
+		    specs.size(),
+		    rosettaTime * 1e3 / scored,
+		    qcpTime * 1e3 / scored,
+		    rosettaTime / qcpTime,
+		    maxRelDiff);
+
+		msg("%s (%lu specs): QCP Double %.1fns/shape, Float %.1fns/shape (%.2fx, worst rel err %.2e), "
+		    "Kahan %.1fns/shape (%.2fx, worst rel err %.2e)\n",
+		    dir,
+		    specs.size(),
+		    qcpTime * 1e3 / scored,
+		    floatTime * 1e3 / scored,
+		    qcpTime / floatTime,
+		    floatMaxRelErr,
+		    kahanTime * 1e3 / scored,
+		    qcpTime / kahanTime,
+		    kahanMaxRelErr);
+
+		if (floatMaxRelErr > mixedTolerance || kahanMaxRelErr > mixedTolerance)
+		{
+			failCount++;
+			err("Mixed precision deviates from double by more than %.1e on %s\n",
+			    mixedTolerance, dir);
+		}
+
+		if (maxRelDiff > tolerance)
+		{
+			failCount++;
+			err("QCP deviates from Rosetta by more than %.1e on %s\n",
+			    tolerance, dir);
+		}
+	}
+
+	return failCount;
+}
+
 } // namespace elfin
@@ -5,6 +5,15 @@
 
 #include "../data/TypeDefs.hpp"
 #include "../data/Gene.hpp"
+#include "SpecScoringContext.hpp"
+#include "ArcLengthIndex.hpp"
+
+// Number of shapes scored side by side by the batched
+// kernel; 8 fills an AVX-512 register of doubles, 16
+// can be used to give the compiler two registers per op
+#ifndef KABSCH_BATCH_LANES
+#define KABSCH_BATCH_LANES 8
+#endif
 
 namespace elfin
 {
@@ -12,14 +21,107 @@ namespace elfin
 float
 kabschScore(
     const Genes & genes,
-    Points3f ref);
+    const Points3f & ref);
 
 float
 kabschScore(
-    Points3f mobile,
-    Points3f ref);
+    const Points3f & mobile,
+    const Points3f & ref);
+
+float
+kabschScore(
+    const Genes & genes,
+    const SpecScoringContext & ctx,
+    const ScoreBackend backend = ScoreBackend::Rosetta);
+
+// Resample pts to the spec's point count by arc length
+void
+resample(
+    const SpecScoringContext & ctx,
+    const Points3f & pts,
+    Points3f & out);
+
+// Turns Kabsch statistics (e0 and the covariance of the
+// centred reference and mobile shapes) into a score
+double
+solveKabschRms(
+    const ScoreBackend backend,
+    const double e0,
+    const double r[3][3]);
+
+/*
+ * Structure-of-arrays block of mobile shapes that have
+ * already been resampled to the length of the reference.
+ *
+ * Shapes are grouped in KABSCH_BATCH_LANES lanes; point m
+ * of the shape in lane l of group g is stored at
+ * [(g * n + m) * KABSCH_BATCH_LANES + l] of xs, ys and zs.
+ */
+class KabschBatch
+{
+public:
+	KabschBatch() {};
+	KabschBatch(const uint n, const uint count);
+	virtual ~KabschBatch() {};
+
+	void resize(const uint n, const uint count);
+	void load(const uint index, const Points3f & pts);
+	void load(const uint index, const Genes & genes, const SpecScoringContext & ctx);
+
+	uint n() const;
+	uint count() const;
+	uint groups() const;
+	const float * xs() const;
+	const float * ys() const;
+	const float * zs() const;
+
+private:
+	uint myN = 0;
+	uint myCount = 0;
+	std::vector<float> myXs, myYs, myZs;
+};
+
+/*
+ * Per-thread buffers used by the scoring path. Once sized
+ * by setupScoringScratch() scoring makes no heap allocations.
+ */
+struct ScoringScratch
+{
+	Points3f mobile;
+	Points3f resampled;
+	ArcLengthIndex mobileIndex;
+	ArcLengthIndex refIndex;
+	KabschBatch batch;
+	std::vector<double> windowPrefix;
+
+	void reserve(const uint maxLen, const uint refLen);
+};
+
+ScoringScratch & getScoringScratch();
+
+// Must be called outside of a parallel region
+void setupScoringScratch(const uint maxLen, const uint refLen);
+
+// Adding a backend only needs a new ScoreBackend entry
+// and a solver for it in Kabsch.cpp
+void
+kabschScoreBatch(
+    const KabschBatch & mobiles,
+    const SpecScoringContext & ctx,
+    float * scoresOut,
+    const ScoreBackend backend = ScoreBackend::Rosetta,
+    const ScorePrecision precision = ScorePrecision::Double);
+
+// Cheap lower bound on the score kabschScoreBatch() would
+// give the shape at index of mobiles
+float
+kabschLowerBound(
+    const KabschBatch & mobiles,
+    const uint index,
+    const SpecScoringContext & ctx);
 
 int _testKabsch();
+int _benchKabsch();
 } // namespace elfin
 
-#endif /* include guard */
\ No newline at end of file
+#endif /* include guard */
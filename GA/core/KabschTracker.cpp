@@ -0,0 +1,114 @@
+#include "KabschTracker.hpp"
+
+#include <cmath>
+
+#include "util.h"
+#include "Kabsch.hpp"
+
+namespace elfin
+{
+
+KabschTracker::KabschTracker(const SpecScoringContext * ctx) :
+	myCtx(ctx)
+{
+	reset();
+}
+
+void
+KabschTracker::reset()
+{
+	myN = 0;
+	myRefSqSum = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		mySum[i] = 0.0;
+		myRefSum[i] = 0.0;
+		for (int j = 0; j < 3; j++)
+		{
+			myMoment[i][j] = 0.0;
+			myCross[i][j] = 0.0;
+		}
+	}
+}
+
+void
+KabschTracker::append(const Point3f & pt)
+{
+	const double x[3] = {pt.x, pt.y, pt.z};
+
+	for (int a = 0; a < 3; a++)
+	{
+		mySum[a] += x[a];
+		for (int b = 0; b < 3; b++)
+			myMoment[a][b] += x[a] * x[b];
+	}
+
+	if (myN < myCtx->size())
+	{
+		const double y[3] = {
+			myCtx->centredX()[myN],
+			myCtx->centredY()[myN],
+			myCtx->centredZ()[myN]
+		};
+
+		for (int i = 0; i < 3; i++)
+		{
+			myRefSum[i] += y[i];
+			myRefSqSum += y[i] * y[i];
+			for (int j = 0; j < 3; j++)
+				myCross[i][j] += y[i] * x[j];
+		}
+	}
+
+	myN++;
+}
+
+uint
+KabschTracker::size() const
+{
+	return myN;
+}
+
+bool
+KabschTracker::scorable() const
+{
+	return myN > 0 && myN <= myCtx->size();
+}
+
+bool
+KabschTracker::complete() const
+{
+	return myN == myCtx->size();
+}
+
+float
+KabschTracker::score(const ScoreBackend backend) const
+{
+	panic_if(!scorable(),
+	         "KabschTracker::score(): %u points cannot pair with spec of %u\n",
+	         myN, myCtx->size());
+
+	double xc[3], yc[3];
+	for (int i = 0; i < 3; i++)
+	{
+		xc[i] = mySum[i] / myN;
+		yc[i] = myRefSum[i] / myN;
+	}
+
+	// Centred sums of squares and covariance
+	double e0 = myRefSqSum;
+	for (int i = 0; i < 3; i++)
+	{
+		e0 += myMoment[i][i] - myN * xc[i] * xc[i];
+		e0 -= myN * yc[i] * yc[i];
+	}
+
+	double r[3][3];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			r[i][j] = myCross[i][j] - myN * yc[i] * xc[j];
+
+	return solveKabschRms(backend, e0, r);
+}
+
+} // namespace elfin
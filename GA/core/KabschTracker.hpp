@@ -0,0 +1,57 @@
+#ifndef _KABSCHTRACKER_HPP_
+#define _KABSCHTRACKER_HPP_
+
+#include "../data/TypeDefs.hpp"
+#include "SpecScoringContext.hpp"
+
+namespace elfin
+{
+
+/*
+ * Kabsch sufficient statistics of a growing chain, paired
+ * point by point with the spec in chain order.
+ *
+ * Synthesis places every gene once, in the frame of the
+ * first gene, and appends it here as it goes. The sums below
+ * only ever grow by one point, so the score of the chain so
+ * far (against the same number of leading spec points) can
+ * be read at any time without another pass over coordinates.
+ */
+class KabschTracker
+{
+public:
+	KabschTracker(const SpecScoringContext * ctx);
+	virtual ~KabschTracker() {};
+
+	void reset();
+
+	// Append the next point of the chain; it pairs with spec
+	// point size() - 1 afterwards
+	void append(const Point3f & pt);
+
+	uint size() const;
+
+	// True while every point has a spec partner
+	bool scorable() const;
+
+	// True when the chain has exactly as many points as the spec
+	bool complete() const;
+
+	// Kabsch score of the tracked prefix against the spec
+	// prefix of the same length
+	float score(const ScoreBackend backend) const;
+
+private:
+	const SpecScoringContext * myCtx;
+
+	uint myN;
+	double mySum[3];        // sum of x
+	double myMoment[3][3];  // sum of x x^T
+	double myCross[3][3];   // sum of y x^T, y from the centred spec
+	double myRefSum[3];     // sum of paired y
+	double myRefSqSum;      // sum of |y|^2 over paired y
+};
+
+} // namespace elfin
+
+#endif /* include guard */
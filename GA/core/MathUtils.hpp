@@ -7,12 +7,46 @@
 #include "../data/TypeDefs.hpp"
 #include "../data/Gene.hpp"
 
-// COLLISION_MEASURE is one of {avgAll, maxHeavy, maxCA}
-#define COLLISION_MEASURE maxHeavy
-
 namespace elfin
 {
 
+// Collision radius of a node under measure M
+template <CollisionMeasure M>
+inline float measureRadius(const Radii & radii);
+
+template <>
+inline float measureRadius<AvgAll>(const Radii & radii)
+{
+	return radii.avgAll;
+}
+
+template <>
+inline float measureRadius<MaxCA>(const Radii & radii)
+{
+	return radii.maxCA;
+}
+
+template <>
+inline float measureRadius<MaxHeavy>(const Radii & radii)
+{
+	return radii.maxHeavy;
+}
+
+// Whether newId at newCOM is too close to an existing gene
+template <CollisionMeasure M = MaxHeavy>
+inline bool
+collidesWith(const uint newId,
+             const Point3f & newCOM,
+             const Gene & gene,
+             const RadiiList & radiiList)
+{
+	const float comDist = gene.com().distTo(newCOM);
+	const float requiredComDist = measureRadius<M>(radiiList.at(gene.nodeId())) +
+	                              measureRadius<M>(radiiList.at(newId));
+	return comDist < requiredComDist;
+}
+
+template <CollisionMeasure M = MaxHeavy>
 inline bool
 collides(const uint newId,
          const Point3f & newCOM,
@@ -23,10 +57,7 @@ collides(const uint newId,
 	// Check collision with all nodes up to previous PAIR
 	for (ConstGeneIterator itr = beginGene; itr < endGene; itr++)
 	{
-		const float comDist = itr->com().distTo(newCOM);
-		const float requiredComDist = radiiList.at(itr->nodeId()).COLLISION_MEASURE +
-		                              radiiList.at(newId).COLLISION_MEASURE;
-		if (comDist < requiredComDist)
+		if (collidesWith<M>(newId, newCOM, *itr, radiiList))
 			return true;
 	}
 
@@ -0,0 +1,217 @@
+#include "RadixSort.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <omp.h>
+
+#include "util.h"
+#include "BenchUtils.hpp"
+#include "../data/Chromosome.hpp"
+
+namespace elfin
+{
+
+void
+radixSortKeys(std::vector<ulong> & items, std::vector<ulong> & scratch)
+{
+	const ulong n = items.size();
+	const uint radix = 1u << RADIX_BITS;
+	scratch.resize(n);
+
+	ulong * src = items.data();
+	ulong * dst = scratch.data();
+
+	const int maxThreads = omp_get_max_threads();
+	std::vector<ulong> counts(maxThreads * radix);
+
+	for (uint shift = 32; shift < 64; shift += RADIX_BITS)
+	{
+		bool uniform = false;
+
+		#pragma omp parallel num_threads(maxThreads)
+		{
+			const int t = omp_get_thread_num();
+			const int nThreads = omp_get_num_threads();
+			const ulong begin = n * t / nThreads;
+			const ulong end = n * (t + 1) / nThreads;
+			ulong * offsets = &counts[t * radix];
+
+			std::fill(offsets, offsets + radix, 0);
+			for (ulong i = begin; i < end; i++)
+				offsets[(src[i] >> shift) & (radix - 1)]++;
+
+			#pragma omp barrier
+			#pragma omp single
+			{
+				// Digit-major, thread-minor, so that the sort
+				// stays stable
+				ulong sum = 0;
+				for (uint d = 0; d < radix; d++)
+				{
+					const ulong start = sum;
+					for (int tt = 0; tt < nThreads; tt++)
+					{
+						const ulong count = counts[tt * radix + d];
+						counts[tt * radix + d] = sum;
+						sum += count;
+					}
+					uniform |= sum - start == n;
+				}
+			}
+
+			if (!uniform)
+			{
+				for (ulong i = begin; i < end; i++)
+					dst[offsets[(src[i] >> shift) & (radix - 1)]++] = src[i];
+			}
+		}
+
+		if (!uniform)
+			std::swap(src, dst);
+	}
+
+	if (src != items.data())
+		items.swap(scratch);
+}
+
+int _testRadixSort()
+{
+	using namespace elfin;
+
+	msg("Testing RadixSort\n");
+
+	uint failCount = 0;
+
+	// Keys must order like the floats they come from
+	const float ordered[] = {
+		-INFINITY, -1e30f, -2.5f, -1.0f, -1e-30f, -0.0f,
+		0.0f, 1e-30f, 1.0f, 2.5f, 1e30f, INFINITY
+	};
+	const int nOrdered = sizeof(ordered) / sizeof(ordered[0]);
+	for (int i = 1; i < nOrdered; i++)
+	{
+		if (floatSortKey(ordered[i - 1]) >= floatSortKey(ordered[i]))
+		{
+			failCount++;
+			err("floatSortKey(%g) >= floatSortKey(%g)\n", ordered[i - 1], ordered[i]);
+		}
+	}
+
+	// Against a stable sort, with few distinct scores so that
+	// stability shows, at sizes around the thread split
+	uint seed = 0x1337;
+	std::vector<ulong> items, expected, scratch;
+	const ulong sizes[] = { 0, 1, 2, 7, 1000, 65537 };
+	for (const ulong n : sizes)
+	{
+		for (int distinct = 1; distinct <= 1000; distinct *= 10)
+		{
+			items.clear();
+			for (ulong i = 0; i < n; i++)
+			{
+				const float score = (rand_r(&seed) % distinct) * 1.5f - 100.0f;
+				items.push_back(radixItem(floatSortKey(score), i));
+			}
+
+			expected = items;
+			std::stable_sort(expected.begin(), expected.end(),
+			[](const ulong a, const ulong b) {
+				return (a >> 32) < (b >> 32);
+			});
+
+			radixSortKeys(items, scratch);
+
+			if (items != expected)
+			{
+				failCount++;
+				err("radixSortKeys() differs from a stable sort on %lu items (%d distinct)\n",
+				    n, distinct);
+			}
+		}
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+int _benchRadixSort()
+{
+	msg("Benchmarking population ranking: std::sort on chromosomes vs radix sorted keys\n");
+
+	const ulong popSize = 65536;
+	const ulong survivors = popSize / 50;
+	const int reps = 5;
+
+	setupBenchChromosome(100);
+
+	uint seed = 0x1337;
+	std::vector<Chromosome> pop;
+	for (ulong i = 0; i < popSize; i++)
+	{
+		Chromosome c(Chromosome::genRandomGenes());
+		c.setScore(rand_r(&seed) % 100000 / 10.0f);
+		pop.push_back(c);
+	}
+
+	int failCount = 0;
+	double objectTime = 0.0, keyTime = 0.0;
+	std::vector<ulong> items, scratch;
+	for (int r = 0; r < reps; r++)
+	{
+		std::vector<Chromosome> sorted = pop;
+		double t0 = get_timestamp_us();
+		std::sort(sorted.begin(), sorted.end());
+		objectTime += get_timestamp_us() - t0;
+
+		// Keys, then the survivors swapped into place
+		std::vector<Chromosome> ranked = pop;
+		t0 = get_timestamp_us();
+		items.resize(popSize);
+		for (ulong i = 0; i < popSize; i++)
+			items[i] = radixItem(floatSortKey(ranked[i].getScore()), i);
+		radixSortKeys(items, scratch);
+
+		std::vector<uint> where(popSize), what(popSize);
+		for (ulong i = 0; i < popSize; i++)
+			where[i] = what[i] = i;
+		for (ulong k = 0; k < survivors; k++)
+		{
+			const uint id = radixPayload(items[k]);
+			const uint from = where[id];
+			ranked[k].swap(ranked[from]);
+			where[what[k]] = from;
+			what[from] = what[k];
+			where[id] = k;
+			what[k] = id;
+		}
+		keyTime += get_timestamp_us() - t0;
+
+		for (ulong i = 0; i < survivors; i++)
+		{
+			if (ranked[i].getScore() != sorted[i].getScore())
+			{
+				failCount++;
+				err("Survivor %lu scores %f, expected %f\n",
+				    i, ranked[i].getScore(), sorted[i].getScore());
+				break;
+			}
+		}
+	}
+
+	msg("%lu chromosomes, %lu survivors: std::sort %.2fms, keys %.2fms (%.2fx)\n",
+	    popSize,
+	    survivors,
+	    objectTime / reps / 1e3,
+	    keyTime / reps / 1e3,
+	    objectTime / keyTime);
+
+	return failCount;
+}
+
+} // namespace elfin
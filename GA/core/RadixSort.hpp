@@ -0,0 +1,51 @@
+#ifndef _RADIXSORT_HPP_
+#define _RADIXSORT_HPP_
+
+#include <vector>
+#include <cstring>
+
+#include "../data/PrimitiveShorthands.hpp"
+
+// Bits sorted per pass
+#define RADIX_BITS 8
+
+namespace elfin
+{
+
+/*
+ * Unsigned key that orders like the float it comes from:
+ * negative floats have all bits flipped, the rest only the
+ * sign bit
+ */
+inline uint floatSortKey(const float f)
+{
+	uint bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// (key, payload) packed for radixSortKeys()
+inline ulong radixItem(const uint key, const uint payload)
+{
+	return ((ulong) key << 32) | payload;
+}
+
+inline uint radixPayload(const ulong item)
+{
+	return (uint) item;
+}
+
+/*
+ * Stable LSD radix sort of radixItem()s by their key, in
+ * parallel: each thread counts and scatters its own stretch of
+ * items. Passes whose digit is the same in every key are
+ * skipped. scratch is resized as needed.
+ */
+void radixSortKeys(std::vector<ulong> & items, std::vector<ulong> & scratch);
+
+int _testRadixSort();
+int _benchRadixSort();
+
+} // namespace elfin
+
+#endif /* include guard */
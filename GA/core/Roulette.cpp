@@ -0,0 +1,107 @@
+#include "Roulette.hpp"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace elfin
+{
+
+void
+Roulette::clear()
+{
+	myItems.clear();
+	myEnds.clear();
+}
+
+void
+Roulette::add(const uint item, const uint weight)
+{
+	if (weight == 0)
+		return;
+
+	myItems.push_back(item);
+	myEnds.push_back(total() + weight);
+}
+
+ulong
+Roulette::total() const
+{
+	return myEnds.empty() ? 0 : myEnds.back();
+}
+
+bool
+Roulette::empty() const
+{
+	return myEnds.empty();
+}
+
+uint
+Roulette::pick(const ulong dice) const
+{
+	panic_if(dice >= total(),
+	         "Roulette::pick(): dice %lu out of [0, %lu)\n", dice, total());
+
+	// First item whose slots end after dice
+	const size_t i = std::upper_bound(myEnds.begin(), myEnds.end(), dice) -
+	                 myEnds.begin();
+	return myItems[i];
+}
+
+int _testRoulette()
+{
+	using namespace elfin;
+
+	msg("Testing Roulette\n");
+
+	uint failCount = 0;
+
+	// Every dice roll against an explicit wheel, refilling
+	// the same roulette like growth does
+	uint seed = 0x1337;
+	Roulette roulette;
+	uint mismatches = 0;
+	for (int t = 0; t < 50; t++)
+	{
+		roulette.clear();
+		std::vector<uint> wheel;
+
+		const uint items = rand_r(&seed) % 20;
+		for (uint item = 0; item < items; item++)
+		{
+			// Include zero weights
+			const uint weight = rand_r(&seed) % 5;
+			roulette.add(item, weight);
+			for (int w = 0; w < weight; w++)
+				wheel.push_back(item);
+		}
+
+		if (roulette.total() != wheel.size() ||
+		        roulette.empty() != wheel.empty())
+		{
+			failCount++;
+			err("Roulette total %lu differs from wheel size %lu\n",
+			    roulette.total(), wheel.size());
+			continue;
+		}
+
+		for (ulong dice = 0; dice < wheel.size(); dice++)
+			mismatches += roulette.pick(dice) != wheel.at(dice);
+	}
+
+	if (mismatches > 0)
+	{
+		failCount++;
+		err("Roulette disagrees with wheel on %u dice rolls\n", mismatches);
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+} // namespace elfin
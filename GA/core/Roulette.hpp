@@ -0,0 +1,45 @@
+#ifndef _ROULETTE_HPP_
+#define _ROULETTE_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+
+namespace elfin
+{
+
+/*
+ * Weighted pick over items by prefix sums of integer
+ * weights. pick(dice) gives the item that a roulette wheel
+ * holding weight copies of each item, in the order they were
+ * added, gives for the same dice roll; the wheel itself is
+ * never built.
+ *
+ * Items of zero weight are skipped, which is how growth
+ * masks out colliding neighbours. clear() keeps capacity,
+ * so a roulette refilled at every growth step does not
+ * allocate.
+ */
+class Roulette
+{
+public:
+	void clear();
+	void add(const uint item, const uint weight);
+
+	// Sum of weights, i.e. the size of the equivalent wheel
+	ulong total() const;
+	bool empty() const;
+
+	// dice must be in [0, total())
+	uint pick(const ulong dice) const;
+
+private:
+	std::vector<uint> myItems;
+	std::vector<ulong> myEnds; // Prefix sums of weights, including own
+};
+
+int _testRoulette();
+
+} // namespace elfin
+
+#endif /* include guard */
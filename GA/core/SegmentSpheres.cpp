@@ -0,0 +1,268 @@
+#include "SegmentSpheres.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "util.h"
+
+namespace elfin
+{
+
+void
+SegmentSpheres::build(const Genes & genes,
+                      const std::vector<float> & radii,
+                      const uint begin,
+                      const uint end)
+{
+	myLevels.resize(1);
+	std::vector<Sphere> & leaves = myLevels.at(0);
+	leaves.clear();
+
+	for (uint b = begin; b < end; b += SEGMENT_SPHERE_LEN)
+	{
+		const uint e = std::min(b + SEGMENT_SPHERE_LEN, end);
+
+		Point3f centre(0, 0, 0);
+		for (uint i = b; i < e; i++)
+			centre += genes.at(i).com();
+		centre = centre * (1.0f / (e - b));
+
+		float radius = 0.0f;
+		for (uint i = b; i < e; i++)
+			radius = std::max(radius,
+			                  centre.distTo(genes.at(i).com()) + radii.at(genes.at(i).nodeId()));
+
+		leaves.push_back({centre, radius + SEGMENT_SPHERE_SLACK, b, e});
+	}
+
+	// Pair up spheres until one is left; an odd one out moves
+	// up as it is
+	while (myLevels.back().size() > 1)
+	{
+		const std::vector<Sphere> & below = myLevels.back();
+		std::vector<Sphere> above;
+		for (uint i = 0; i < below.size(); i += 2)
+		{
+			if (i + 1 < below.size())
+				above.push_back(enclose(below.at(i), below.at(i + 1)));
+			else
+				above.push_back(below.at(i));
+		}
+		myLevels.push_back(above);
+	}
+}
+
+bool
+SegmentSpheres::collidesWith(const SegmentSpheres & rhs,
+                             const Genes & genes,
+                             const std::vector<float> & radii,
+                             const uint minGap) const
+{
+	myLastVisits = 0;
+	if (myLevels.empty() || myLevels.at(0).empty() ||
+	        rhs.myLevels.empty() || rhs.myLevels.at(0).empty())
+		return false;
+
+	myStack.clear();
+	myStack.push_back({(uint) myLevels.size() - 1, 0,
+	                   (uint) rhs.myLevels.size() - 1, 0});
+
+	while (!myStack.empty())
+	{
+		const Visit v = myStack.back();
+		myStack.pop_back();
+		myLastVisits++;
+
+		const Sphere & a = myLevels.at(v.lhsLevel).at(v.lhsIndex);
+		const Sphere & b = rhs.myLevels.at(v.rhsLevel).at(v.rhsIndex);
+
+		const float reach = a.radius + b.radius;
+		const Point3f d = a.centre - b.centre;
+		if (d.x * d.x + d.y * d.y + d.z * d.z >= reach * reach)
+			continue;
+
+		if (v.lhsLevel == 0 && v.rhsLevel == 0)
+		{
+			if (leavesCollide(a, b, genes, radii, minGap))
+				return true;
+			continue;
+		}
+
+		// Open the sphere higher up; children of sphere i at
+		// level l are 2i and 2i + 1 at level l - 1 (if any)
+		const bool openLhs = v.lhsLevel >= v.rhsLevel;
+		const uint level = (openLhs ? v.lhsLevel : v.rhsLevel) - 1;
+		const uint first = 2 * (openLhs ? v.lhsIndex : v.rhsIndex);
+		const uint count = (openLhs ? myLevels : rhs.myLevels).at(level).size();
+		for (uint c = first; c < std::min(first + 2, count); c++)
+		{
+			if (openLhs)
+				myStack.push_back({level, c, v.rhsLevel, v.rhsIndex});
+			else
+				myStack.push_back({v.lhsLevel, v.lhsIndex, level, c});
+		}
+	}
+
+	return false;
+}
+
+uint
+SegmentSpheres::levels() const
+{
+	return myLevels.size();
+}
+
+uint
+SegmentSpheres::lastVisits() const
+{
+	return myLastVisits;
+}
+
+// Private methods
+
+SegmentSpheres::Sphere
+SegmentSpheres::enclose(const Sphere & a, const Sphere & b)
+{
+	const Sphere * big = a.radius >= b.radius ? &a : &b;
+	const Sphere * small = a.radius >= b.radius ? &b : &a;
+	const float dist = a.centre.distTo(b.centre);
+	const uint begin = std::min(a.begin, b.begin);
+	const uint end = std::max(a.end, b.end);
+
+	if (dist + small->radius <= big->radius)
+		return {big->centre, big->radius, begin, end};
+
+	const float radius = (dist + a.radius + b.radius) / 2;
+	const Point3f centre = a.centre + (b.centre - a.centre) * ((radius - a.radius) / dist);
+
+	return {centre, radius + SEGMENT_SPHERE_SLACK, begin, end};
+}
+
+bool
+SegmentSpheres::leavesCollide(const Sphere & lhs,
+                              const Sphere & rhs,
+                              const Genes & genes,
+                              const std::vector<float> & radii,
+                              const uint minGap) const
+{
+	for (uint i = lhs.begin; i < lhs.end; i++)
+	{
+		const Gene & gi = genes.at(i);
+		const float ri = radii.at(gi.nodeId());
+
+		for (uint k = rhs.begin; k < rhs.end; k++)
+		{
+			if ((i > k ? i - k : k - i) < minGap)
+				continue;
+
+			const Gene & gk = genes.at(k);
+			const float reach = ri + radii.at(gk.nodeId());
+			const Point3f d = gi.com() - gk.com();
+			if (d.x * d.x + d.y * d.y + d.z * d.z < reach * reach)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+int _testSegmentSpheres()
+{
+	using namespace elfin;
+
+	msg("Testing SegmentSpheres\n");
+
+	uint failCount = 0;
+
+	uint seed = 0x1337;
+	auto randf = [&seed](const float amplitude) {
+		return amplitude * (2.0f * rand_r(&seed) / RAND_MAX - 1.0f);
+	};
+
+	std::vector<float> radii;
+	for (int i = 0; i < 10; i++)
+		radii.push_back(3.0f + (rand_r(&seed) % 100) / 20.0f);
+
+	// Random walks split in two; the hierarchy must agree with
+	// testing every pair across the split
+	SegmentSpheres lhs, rhs;
+	uint mismatches = 0, hits = 0, cheap = 0;
+	const uint trials = 400;
+	for (int t = 0; t < trials; t++)
+	{
+		const uint n = 2 + rand_r(&seed) % 120;
+		const uint split = 1 + rand_r(&seed) % (n - 1);
+		const float step = 4.0f + randf(2.0f);
+
+		Genes genes;
+		Point3f pt(0, 0, 0);
+		for (int i = 0; i < n; i++)
+		{
+			pt += Point3f(randf(step), randf(step), randf(step));
+			genes.emplace_back(rand_r(&seed) % radii.size(), pt);
+		}
+
+		const uint minGap = rand_r(&seed) % 5;
+
+		bool linear = false;
+		for (int i = 0; i < split && !linear; i++)
+		{
+			for (int k = split; k < n && !linear; k++)
+			{
+				if (k - i < minGap)
+					continue;
+
+				const float reach = radii.at(genes.at(i).nodeId()) +
+				                    radii.at(genes.at(k).nodeId());
+				const Point3f d = genes.at(i).com() - genes.at(k).com();
+				linear = d.x * d.x + d.y * d.y + d.z * d.z < reach * reach;
+			}
+		}
+
+		lhs.build(genes, radii, 0, split);
+		rhs.build(genes, radii, split, n);
+		const bool tree = lhs.collidesWith(rhs, genes, radii, minGap);
+
+		mismatches += tree != linear;
+		hits += linear;
+
+		// A copy moved far away must be ruled out at the top
+		Genes far = genes;
+		for (int i = split; i < n; i++)
+			far.at(i).com() += Point3f(1e4f, 0, 0);
+		rhs.build(far, radii, split, n);
+		lhs.build(far, radii, 0, split);
+		if (lhs.collidesWith(rhs, far, radii, minGap) || lhs.lastVisits() != 1)
+			cheap++;
+	}
+
+	if (mismatches > 0)
+	{
+		failCount++;
+		err("SegmentSpheres disagrees with a pairwise scan on %u of %u splits\n",
+		    mismatches, trials);
+	}
+
+	if (hits == 0 || hits == trials)
+	{
+		failCount++;
+		err("Test splits are all hits or all misses (%u of %u)\n", hits, trials);
+	}
+
+	if (cheap > 0)
+	{
+		failCount++;
+		err("Distant pieces took more than one sphere test %u times\n", cheap);
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+} // namespace elfin
@@ -0,0 +1,88 @@
+#ifndef _SEGMENTSPHERES_HPP_
+#define _SEGMENTSPHERES_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+#include "../data/Gene.hpp"
+
+// Genes per leaf sphere
+#ifndef SEGMENT_SPHERE_LEN
+#define SEGMENT_SPHERE_LEN 8
+#endif
+
+// Added to every sphere so that rounding never leaves a gene
+// poking out of the sphere that should hold it
+#define SEGMENT_SPHERE_SLACK 1e-2f
+
+namespace elfin
+{
+
+/*
+ * Bounding-sphere hierarchy over a contiguous range of a
+ * chain. Leaves hold SEGMENT_SPHERE_LEN consecutive genes,
+ * grown by each gene's collision radius; every level above
+ * encloses pairs of spheres of the level below, up to one
+ * sphere over the whole range.
+ *
+ * Two pieces that are each free of collisions, like the two
+ * halves of a crossed chain, only need their pairs across
+ * the pieces tested. collidesWith() does that by descending
+ * only into sphere pairs that overlap, so pieces far apart
+ * cost one test.
+ */
+class SegmentSpheres
+{
+public:
+	// Spheres over genes [begin, end), which must be placed
+	// in a common frame; radii are by node ID
+	void build(const Genes & genes,
+	           const std::vector<float> & radii,
+	           const uint begin,
+	           const uint end);
+
+	// Whether any gene of these collides with any gene of
+	// rhs, both built over the same genes; pairs fewer than
+	// minGap genes apart are not tested
+	bool collidesWith(const SegmentSpheres & rhs,
+	                  const Genes & genes,
+	                  const std::vector<float> & radii,
+	                  const uint minGap) const;
+
+	uint levels() const;
+
+	// Sphere pairs looked at by the last collidesWith()
+	uint lastVisits() const;
+
+private:
+	struct Sphere
+	{
+		Point3f centre;
+		float radius;
+		uint begin, end; // Genes covered
+	};
+
+	static Sphere enclose(const Sphere & a, const Sphere & b);
+
+	bool leavesCollide(const Sphere & lhs,
+	                   const Sphere & rhs,
+	                   const Genes & genes,
+	                   const std::vector<float> & radii,
+	                   const uint minGap) const;
+
+	// Level 0 holds the leaves; the last level one sphere
+	std::vector<std::vector<Sphere>> myLevels;
+
+	struct Visit
+	{
+		uint lhsLevel, lhsIndex, rhsLevel, rhsIndex;
+	};
+	mutable std::vector<Visit> myStack;
+	mutable uint myLastVisits = 0;
+};
+
+int _testSegmentSpheres();
+
+} // namespace elfin
+
+#endif /* include guard */
@@ -0,0 +1,157 @@
+#include "SpecScoringContext.hpp"
+
+#include "util.h"
+
+namespace elfin
+{
+
+SpecScoringContext::SpecScoringContext(const Points3f & spec,
+                                       const uint minLen,
+                                       const uint maxLen) :
+	mySpec(spec),
+	myMinLen(minLen),
+	myMaxLen(maxLen)
+{
+	const uint n = mySpec.size();
+	panic_if(n < 1, "SpecScoringContext(): spec is empty\n");
+
+	// Centre, accumulated in the same order as Kabsch
+	myCentre[0] = myCentre[1] = myCentre[2] = 0.0;
+	for (int m = 0; m < n; m++)
+	{
+		myCentre[0] += mySpec.at(m).x;
+		myCentre[1] += mySpec.at(m).y;
+		myCentre[2] += mySpec.at(m).z;
+	}
+	for (int i = 0; i < 3; i++)
+		myCentre[i] = myCentre[i] / n;
+
+	myCentredX.resize(n);
+	myCentredY.resize(n);
+	myCentredZ.resize(n);
+	mySqNormSum = 0.0;
+	for (int m = 0; m < n; m++)
+	{
+		const double dx = mySpec.at(m).x - myCentre[0];
+		const double dy = mySpec.at(m).y - myCentre[1];
+		const double dz = mySpec.at(m).z - myCentre[2];
+		myCentredX.at(m) = dx;
+		myCentredY.at(m) = dy;
+		myCentredZ.at(m) = dz;
+		mySqNormSum += dx * dx;
+		mySqNormSum += dy * dy;
+		mySqNormSum += dz * dz;
+	}
+
+	myCentredXf.assign(myCentredX.begin(), myCentredX.end());
+	myCentredYf.assign(myCentredY.begin(), myCentredY.end());
+	myCentredZf.assign(myCentredZ.begin(), myCentredZ.end());
+
+	myEndToEnd = mySpec.at(n - 1).distTo(mySpec.at(0));
+
+	myArcIndex.build(mySpec);
+}
+
+const Points3f &
+SpecScoringContext::spec() const
+{
+	return mySpec;
+}
+
+uint
+SpecScoringContext::size() const
+{
+	return mySpec.size();
+}
+
+uint
+SpecScoringContext::minLen() const
+{
+	return myMinLen;
+}
+
+uint
+SpecScoringContext::maxLen() const
+{
+	return myMaxLen;
+}
+
+bool
+SpecScoringContext::needsResample(const uint len) const
+{
+	return len != mySpec.size();
+}
+
+const double *
+SpecScoringContext::centre() const
+{
+	return myCentre;
+}
+
+const std::vector<double> &
+SpecScoringContext::centredX() const
+{
+	return myCentredX;
+}
+
+const std::vector<double> &
+SpecScoringContext::centredY() const
+{
+	return myCentredY;
+}
+
+const std::vector<double> &
+SpecScoringContext::centredZ() const
+{
+	return myCentredZ;
+}
+
+const std::vector<float> &
+SpecScoringContext::centredXf() const
+{
+	return myCentredXf;
+}
+
+const std::vector<float> &
+SpecScoringContext::centredYf() const
+{
+	return myCentredYf;
+}
+
+const std::vector<float> &
+SpecScoringContext::centredZf() const
+{
+	return myCentredZf;
+}
+
+double
+SpecScoringContext::sqNormSum() const
+{
+	return mySqNormSum;
+}
+
+double
+SpecScoringContext::endToEnd() const
+{
+	return myEndToEnd;
+}
+
+const std::vector<float> &
+SpecScoringContext::arcProportions() const
+{
+	return myArcIndex.proportions();
+}
+
+float
+SpecScoringContext::totalLength() const
+{
+	return myArcIndex.totalLength();
+}
+
+const ArcLengthIndex &
+SpecScoringContext::arcIndex() const
+{
+	return myArcIndex;
+}
+
+} // namespace elfin
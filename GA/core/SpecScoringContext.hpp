@@ -0,0 +1,81 @@
+#ifndef _SPECSCORINGCONTEXT_HPP_
+#define _SPECSCORINGCONTEXT_HPP_
+
+#include <vector>
+
+#include "../data/TypeDefs.hpp"
+#include "ArcLengthIndex.hpp"
+
+namespace elfin
+{
+
+/*
+ * Everything scoring needs to know about the spec that
+ * does not depend on the mobile shape. The spec never
+ * changes during a run so this is built once and shared
+ * read-only by all threads.
+ *
+ * Mobile shapes are always resampled to the spec's point
+ * count, so the same centred spec and arc-length table
+ * serve every chromosome length in [minLen, maxLen].
+ */
+class SpecScoringContext
+{
+public:
+	SpecScoringContext(const Points3f & spec,
+	                   const uint minLen,
+	                   const uint maxLen);
+	virtual ~SpecScoringContext() {};
+
+	const Points3f & spec() const;
+	uint size() const;
+	uint minLen() const;
+	uint maxLen() const;
+
+	// Whether a chromosome of given length must be
+	// resampled before it can be paired with the spec
+	bool needsResample(const uint len) const;
+
+	// Centre of the spec and the spec about its centre
+	const double * centre() const;
+	const std::vector<double> & centredX() const;
+	const std::vector<double> & centredY() const;
+	const std::vector<double> & centredZ() const;
+
+	// Float copies for the mixed precision kernels
+	const std::vector<float> & centredXf() const;
+	const std::vector<float> & centredYf() const;
+	const std::vector<float> & centredZf() const;
+
+	// Sum of squared norms of the centred spec; the spec's
+	// part of Kabsch's e0
+	double sqNormSum() const;
+
+	// Distance between the first and last spec points
+	double endToEnd() const;
+
+	// Cumulative arc length proportions: entry m is the
+	// fraction of total spec length covered at point m
+	const std::vector<float> & arcProportions() const;
+	float totalLength() const;
+
+	// Arc length index of the spec; also gives coarse,
+	// downsampled versions of it
+	const ArcLengthIndex & arcIndex() const;
+
+private:
+	const Points3f mySpec;
+	const uint myMinLen;
+	const uint myMaxLen;
+
+	double myCentre[3];
+	std::vector<double> myCentredX, myCentredY, myCentredZ;
+	std::vector<float> myCentredXf, myCentredYf, myCentredZf;
+	double mySqNormSum;
+	double myEndToEnd;
+	ArcLengthIndex myArcIndex;
+};
+
+} // namespace elfin
+
+#endif /* include guard */
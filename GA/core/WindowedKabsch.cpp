@@ -0,0 +1,250 @@
+#include "WindowedKabsch.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "util.h"
+#include "Kabsch.hpp"
+#include "BenchUtils.hpp"
+
+namespace elfin
+{
+
+uint
+windowStep(const uint windowLen, const float overlapRatio)
+{
+	panic_if(overlapRatio < 0.0f || overlapRatio >= 1.0f,
+	         "Window overlap ratio must be in [0, 1) but is %.2f\n",
+	         overlapRatio);
+
+	const uint overlap = (uint) (overlapRatio * windowLen);
+	return std::max(windowLen - overlap, 1u);
+}
+
+/*
+ * Kabsch statistics of window [start, start + len) from
+ * prefix entries start and start + len. Both shapes were
+ * centred on their global centres before summing so that
+ * the differences below do not lose precision.
+ */
+static float
+windowScore(
+    const double * prefix,
+    const uint start,
+    const uint len,
+    const ScoreBackend backend)
+{
+	const double * a = prefix + (size_t) start * WINDOW_PREFIX_TERMS;
+	const double * b = prefix + (size_t) (start + len) * WINDOW_PREFIX_TERMS;
+
+	double d[WINDOW_PREFIX_TERMS];
+	for (int t = 0; t < WINDOW_PREFIX_TERMS; t++)
+		d[t] = b[t] - a[t];
+
+	const double * sx = d;
+	const double * sy = d + 3;
+	const double sxx = d[6];
+	const double syy = d[7];
+	const double * sxy = d + 8;
+
+	double e0 = sxx + syy;
+	double r[3][3];
+	for (int i = 0; i < 3; i++)
+	{
+		e0 -= (sx[i] * sx[i] + sy[i] * sy[i]) / len;
+		for (int j = 0; j < 3; j++)
+			r[i][j] = sxy[i * 3 + j] - sy[i] * sx[j] / len;
+	}
+
+	return solveKabschRms(backend, e0, r);
+}
+
+WindowStats
+windowedKabsch(
+    const Points3f & mobile,
+    const SpecScoringContext & ctx,
+    const uint windowLen,
+    const uint windowStep,
+    const ScoreBackend backend)
+{
+	const uint n = ctx.size();
+	panic_if(mobile.size() != n,
+	         "windowedKabsch(): mobile has %lu points but spec has %u\n",
+	         mobile.size(), n);
+	panic_if(windowStep < 1, "windowedKabsch(): window step must be positive\n");
+
+	const uint w = (windowLen == 0 || windowLen > n) ? n : windowLen;
+
+	double xc[3] = {0.0, 0.0, 0.0};
+	for (int m = 0; m < n; m++)
+	{
+		xc[0] += mobile[m].x;
+		xc[1] += mobile[m].y;
+		xc[2] += mobile[m].z;
+	}
+	for (int i = 0; i < 3; i++)
+		xc[i] = xc[i] / n;
+
+	// Prefix entry m sums points [0, m)
+	std::vector<double> & prefix = getScoringScratch().windowPrefix;
+	prefix.assign((size_t) (n + 1) * WINDOW_PREFIX_TERMS, 0.0);
+
+	const double * yx = ctx.centredX().data();
+	const double * yy = ctx.centredY().data();
+	const double * yz = ctx.centredZ().data();
+	for (int m = 0; m < n; m++)
+	{
+		const double x[3] = {
+			mobile[m].x - xc[0],
+			mobile[m].y - xc[1],
+			mobile[m].z - xc[2]
+		};
+		const double y[3] = {yx[m], yy[m], yz[m]};
+
+		const double * prev = prefix.data() + (size_t) m * WINDOW_PREFIX_TERMS;
+		double * curr = prefix.data() + (size_t) (m + 1) * WINDOW_PREFIX_TERMS;
+
+		for (int i = 0; i < 3; i++)
+		{
+			curr[i] = prev[i] + x[i];
+			curr[3 + i] = prev[3 + i] + y[i];
+		}
+		curr[6] = prev[6] + x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+		curr[7] = prev[7] + y[0] * y[0] + y[1] * y[1] + y[2] * y[2];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				curr[8 + i * 3 + j] = prev[8 + i * 3 + j] + y[i] * x[j];
+	}
+
+	WindowStats stats;
+	stats.minRmsd = INFINITY;
+	double rmsdSum = 0.0;
+
+	uint start = 0;
+	while (true)
+	{
+		const float score = windowScore(prefix.data(), start, w, backend);
+		const float rmsd = sqrt(score / w);
+
+		stats.sum += score;
+		stats.minRmsd = std::min(stats.minRmsd, rmsd);
+		stats.maxRmsd = std::max(stats.maxRmsd, rmsd);
+		rmsdSum += rmsd;
+		stats.count++;
+
+		if (start + w >= n)
+			break;
+
+		// Last window is aligned to the end of the shape
+		start = std::min(start + windowStep, n - w);
+	}
+
+	stats.avgRmsd = rmsdSum / stats.count;
+
+	return stats;
+}
+
+WindowStats
+windowedKabsch(
+    const Genes & genes,
+    const SpecScoringContext & ctx,
+    const uint windowLen,
+    const uint windowStep,
+    const ScoreBackend backend)
+{
+	ScoringScratch & scratch = getScoringScratch();
+	Points3f & mobile = scratch.mobile;
+	mobile.resize(genes.size());
+
+	for (int i = 0; i < genes.size(); i++)
+		mobile.at(i) = genes.at(i).com();
+
+	if (ctx.needsResample(mobile.size()))
+	{
+		resample(ctx, mobile, scratch.resampled);
+		return windowedKabsch(scratch.resampled, ctx, windowLen, windowStep, backend);
+	}
+
+	return windowedKabsch(mobile, ctx, windowLen, windowStep, backend);
+}
+
+int _testWindowedKabsch()
+{
+	using namespace elfin;
+
+	msg("Testing WindowedKabsch\n");
+
+	uint failCount = 0;
+
+	const std::vector<BenchSpec> specs =
+	    loadBenchSpecs(std::string(BENCH_SPEC_ROOT) + "l20");
+	if (specs.size() == 0)
+	{
+		failCount++;
+		err("No specs to test WindowedKabsch with\n");
+	}
+
+	uint seed = 0x1337;
+	for (const auto & spec : specs)
+	{
+		const uint n = spec.coms.size();
+		const SpecScoringContext ctx(spec.coms, n, n);
+		const Points3f mobile = jitterPoints(spec.coms, 10.0f, seed);
+
+		// A single window is the global score
+		const float global = kabschScore(mobile, spec.coms);
+		const WindowStats whole = windowedKabsch(mobile, ctx, 0, 1);
+		if (whole.count != 1 ||
+		        !float_approximates_err(whole.sum, global, 1e-3 * (1 + global)))
+		{
+			failCount++;
+			err("Single window score %f differs from global %f on %s\n",
+			    whole.sum, global, spec.name.c_str());
+		}
+
+		// Every window against a separate Kabsch of its points
+		const uint windowLen = 5;
+		const uint step = windowStep(windowLen, 0.5f);
+		const WindowStats windowed = windowedKabsch(mobile, ctx, windowLen, step);
+
+		float sum = 0.0f;
+		uint count = 0;
+		for (uint start = 0; ; start = std::min(start + step, n - windowLen))
+		{
+			const Points3f subMobile(mobile.begin() + start,
+			                         mobile.begin() + start + windowLen);
+			const Points3f subSpec(spec.coms.begin() + start,
+			                       spec.coms.begin() + start + windowLen);
+			sum += kabschScore(subMobile, subSpec);
+			count++;
+
+			if (start + windowLen >= n)
+				break;
+		}
+
+		if (windowed.count != count ||
+		        !float_approximates_err(windowed.sum, sum, 1e-3 * (1 + sum)))
+		{
+			failCount++;
+			err("Windowed score %f (%u windows) differs from %f (%u) on %s\n",
+			    windowed.sum, windowed.count, sum, count, spec.name.c_str());
+		}
+
+		if (!(windowed.minRmsd <= windowed.avgRmsd &&
+		        windowed.avgRmsd <= windowed.maxRmsd))
+		{
+			failCount++;
+			err("Window RMSD stats out of order on %s\n", spec.name.c_str());
+		}
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+} // namespace elfin
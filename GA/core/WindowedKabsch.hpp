@@ -0,0 +1,69 @@
+#ifndef _WINDOWEDKABSCH_HPP_
+#define _WINDOWEDKABSCH_HPP_
+
+#include "../data/TypeDefs.hpp"
+#include "../data/Gene.hpp"
+#include "SpecScoringContext.hpp"
+
+// Prefix sums kept per point: sum x (3), sum y (3),
+// sum |x|^2, sum |y|^2 and sum y x^T (9)
+#define WINDOW_PREFIX_TERMS 17
+
+namespace elfin
+{
+
+/*
+ * Local (sliding window) Kabsch fit of a shape against the
+ * spec: every window of windowLen paired points is
+ * superimposed on its own. This is the windowed RMSD that
+ * scripts/Python/RMSDStat.py reports, computed on CoMs.
+ */
+struct WindowStats
+{
+	// Sum of per-window scores (squared deviations, as
+	// kabschScore()); this is the windowed GA fitness
+	float sum = 0.0f;
+
+	// Per-window RMSD, sqrt(score / windowLen)
+	float minRmsd = 0.0f;
+	float avgRmsd = 0.0f;
+	float maxRmsd = 0.0f;
+
+	uint count = 0;
+};
+
+// Window start step for an overlap ratio in [0, 1)
+uint windowStep(const uint windowLen, const float overlapRatio);
+
+/*
+ * Windows start every windowStep points; a last window is
+ * aligned to the end of the shape so that every point is
+ * covered. A windowLen of 0 or at least the spec length
+ * gives a single window, i.e. the global score.
+ *
+ * Prefix sums of coordinates and of their outer products
+ * give every window's covariance in O(1), so all windows
+ * cost O(n) plus one eigen-solve each.
+ */
+WindowStats
+windowedKabsch(
+    const Points3f & mobile,
+    const SpecScoringContext & ctx,
+    const uint windowLen,
+    const uint windowStep,
+    const ScoreBackend backend = ScoreBackend::Rosetta);
+
+// Resamples genes to the spec first, like kabschScore()
+WindowStats
+windowedKabsch(
+    const Genes & genes,
+    const SpecScoringContext & ctx,
+    const uint windowLen,
+    const uint windowStep,
+    const ScoreBackend backend = ScoreBackend::Rosetta);
+
+int _testWindowedKabsch();
+
+} // namespace elfin
+
+#endif /* include guard */
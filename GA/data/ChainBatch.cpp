@@ -0,0 +1,583 @@
+#include "ChainBatch.hpp"
+
+#include <algorithm>
+
+#include "PairRelationship.hpp"
+#include "../core/ParallelUtils.hpp"
+#include "../core/BenchUtils.hpp"
+#include "../core/MathUtils.hpp"
+#include "../core/ExclusionTable.hpp"
+
+namespace elfin
+{
+
+#define LANES CHAIN_BATCH_LANES
+#define FRAME_TRAN 9
+
+void
+ChainBatch::randomise(Chromosome * chromos, const size_t count)
+{
+	static thread_local std::vector<Chromosome *> pointers;
+	pointers.resize(count);
+	for (size_t i = 0; i < count; i++)
+		pointers.at(i) = &chromos[i];
+
+	randomiseEach(pointers.data(), count);
+}
+
+void
+ChainBatch::randomiseEach(Chromosome * const * chromos, const size_t count)
+{
+	const uint maxLen = Chromosome::myMaxLen;
+	if (myIds.size() < (size_t) maxLen * LANES)
+	{
+		myIds.resize((size_t) maxLen * LANES);
+		myXs.resize((size_t) maxLen * LANES);
+		myYs.resize((size_t) maxLen * LANES);
+		myZs.resize((size_t) maxLen * LANES);
+		myRadii.resize((size_t) maxLen * LANES);
+	}
+
+	if (myCandidates.empty())
+		buildCandidates();
+
+	myChromos = chromos;
+
+	std::vector<uint> pending(count);
+	for (uint i = 0; i < pending.size(); i++)
+		pending.at(i) = i;
+
+	while (!pending.empty())
+	{
+		myRejected.clear();
+		for (size_t begin = 0; begin < pending.size(); begin += LANES)
+		{
+			start(pending.data() + begin,
+			      std::min(pending.size() - begin, (size_t) LANES));
+			grow();
+		}
+
+		Chromosome::myRandomiseRejects.fetch_add(myRejected.size(),
+		        std::memory_order_relaxed);
+		pending.swap(myRejected);
+	}
+
+	myChromos = NULL;
+}
+
+// Private methods
+
+void
+ChainBatch::buildCandidates()
+{
+	const std::vector<WeightedNeighbours> & allNeighbours = Chromosome::myRhsNeighbours;
+	const std::vector<float> & radii = CollisionGrid::nodeRadii();
+
+	myMaxDegree = 0;
+	for (const auto & neighbours : allNeighbours)
+		myMaxDegree = std::max(myMaxDegree, (uint) neighbours.size());
+
+	myCandidates.assign(allNeighbours.size() * myMaxDegree, Candidate());
+	for (uint i = 0; i < allNeighbours.size(); i++)
+	{
+		for (uint j = 0; j < allNeighbours.at(i).size(); j++)
+		{
+			const Chromosome::WeightedNeighbour & nb = allNeighbours.at(i).at(j);
+			Candidate & cand = myCandidates.at(i * myMaxDegree + j);
+			cand.x = nb.pr->comB.x;
+			cand.y = nb.pr->comB.y;
+			cand.z = nb.pr->comB.z;
+			cand.radius = radii.at(nb.nodeId);
+			cand.weight = nb.weight;
+			cand.reach = Chromosome::myRhsReach.at(nb.nodeId);
+		}
+	}
+}
+
+void
+ChainBatch::start(const uint * slots, const uint count)
+{
+	const std::vector<float> & radii = CollisionGrid::nodeRadii();
+	const Roulette & globalRoulette = Chromosome::myGlobalRoulette;
+
+	myLanes = count;
+	myLen = 1;
+
+	for (uint c = 0; c < count; c++)
+	{
+		mySlots[c] = slots[c];
+
+		// Pick random starting node
+		const uint nodeId = globalRoulette.pick(getDice(globalRoulette.total()));
+		myIds[c] = nodeId;
+		myXs[c] = myYs[c] = myZs[c] = 0.0f;
+		myRadii[c] = radii.at(nodeId);
+
+		for (int k = 0; k < CHAIN_BATCH_FRAME; k++)
+		{
+			const double identity = (k < FRAME_TRAN && k % 4 == 0) ? 1.0 : 0.0;
+			myTipToWorld[k][c] = identity;
+			myWorldToTip[k][c] = identity;
+		}
+	}
+}
+
+void
+ChainBatch::grow()
+{
+	const std::vector<WeightedNeighbours> & allNeighbours = Chromosome::myRhsNeighbours;
+	const std::vector<float> & radii = CollisionGrid::nodeRadii();
+	const uint minLen = Chromosome::myMinLen;
+	const uint maxLen = Chromosome::myMaxLen;
+
+	double (* const t2w)[LANES] = myTipToWorld;
+	double (* const w2t)[LANES] = myWorldToTip;
+
+	while (myLanes > 0)
+	{
+		if (myLen >= maxLen)
+		{
+			while (myLanes > 0)
+				retire(myLanes - 1);
+			break;
+		}
+
+		sortLanes();
+
+		const uint * tips = &myIds[(myLen - 1) * LANES];
+		const uint minReach = minLen > myLen + 1 ? minLen - myLen - 1 : 0;
+		const uint maxDegree = myDegrees[0];
+
+		std::fill(myTotals, myTotals + myLanes, 0);
+
+		// Neighbours that hit the gene three back
+		for (uint c = 0; c < myLanes && myLen >= 3; c++)
+			myExcludedRows[c] = ExclusionTable::rhsRow(myIds[(myLen - 3) * LANES + c],
+			                                           myIds[(myLen - 2) * LANES + c],
+			                                           tips[c]);
+		if (myEnds.size() < (size_t) maxDegree * LANES)
+			myEnds.resize((size_t) maxDegree * LANES);
+
+		// Neighbour j of every lane's tip at once; only the
+		// lanes whose tip has a j-th neighbour take part
+		uint lanes = myLanes;
+		for (uint j = 0; j < maxDegree; j++)
+		{
+			while (myDegrees[lanes - 1] <= j)
+				lanes--;
+
+			for (uint c = 0; c < lanes; c++)
+			{
+				const Candidate & cand = myCandidates[tips[c] * myMaxDegree + j];
+				myLive[c] = cand.reach >= minReach &&
+				            (myLen < 3 || !myExcludedRows[c][j]);
+				myCandX[c] = cand.x;
+				myCandY[c] = cand.y;
+				myCandZ[c] = cand.z;
+				myCandRadii[c] = cand.radius;
+			}
+
+			// Into world frame, as RigidTransform::apply()
+			#pragma omp simd
+			for (uint c = 0; c < lanes; c++)
+			{
+				const double x = myCandX[c], y = myCandY[c], z = myCandZ[c];
+				myCandX[c] = x * t2w[0][c] + y * t2w[3][c] + z * t2w[6][c] + t2w[9][c];
+				myCandY[c] = x * t2w[1][c] + y * t2w[4][c] + z * t2w[7][c] + t2w[10][c];
+				myCandZ[c] = x * t2w[2][c] + y * t2w[5][c] + z * t2w[8][c] + t2w[11][c];
+				myHits[c] = 0;
+			}
+
+			// The tip and the gene before it are never tested,
+			// and the one before that was looked up
+			for (uint g = 0; g + 3 < myLen; g++)
+			{
+				const float * xs = &myXs[g * LANES];
+				const float * ys = &myYs[g * LANES];
+				const float * zs = &myZs[g * LANES];
+				const float * rs = &myRadii[g * LANES];
+
+				#pragma omp simd
+				for (uint c = 0; c < lanes; c++)
+				{
+					const float dx = xs[c] - myCandX[c];
+					const float dy = ys[c] - myCandY[c];
+					const float dz = zs[c] - myCandZ[c];
+					const float reachSum = rs[c] + myCandRadii[c];
+					myHits[c] |= (dx * dx + dy * dy + dz * dz) < reachSum * reachSum;
+				}
+			}
+
+			uint * ends = &myEnds[j * LANES];
+			for (uint c = 0; c < lanes; c++)
+			{
+				if (myLive[c] && !myHits[c])
+					myTotals[c] += myCandidates[tips[c] * myMaxDegree + j].weight;
+				ends[c] = myTotals[c];
+			}
+		}
+
+		// Pick a random valid neighbour per lane, as
+		// Roulette::pick() would
+		lanes = myLanes;
+		for (uint c = 0; c < lanes; c++)
+		{
+			myChoices[c] = -1;
+			if (myTotals[c] == 0)
+				continue;
+
+			const uint dice = getDice(myTotals[c]);
+			uint j = 0;
+			while (myEnds[j * LANES + c] <= dice)
+				j++;
+			myChoices[c] = j;
+		}
+
+		// Retire stuck lanes from the back so that the lane
+		// moved into a retired one has been looked at
+		for (int c = (int) lanes - 1; c >= 0; c--)
+			if (myChoices[c] < 0)
+				retire(c);
+
+		if (myLanes == 0)
+			break;
+
+		// Grow every live lane by its pick, as
+		// Chromosome::GrowthFrames::growForward()
+		const uint n = myLanes;
+		tips = &myIds[(myLen - 1) * LANES];
+		uint * newIds = &myIds[myLen * LANES];
+
+		double rot[9][LANES], rotInv[9][LANES], tran[3][LANES];
+		for (uint c = 0; c < n; c++)
+		{
+			const Chromosome::WeightedNeighbour & next =
+			    allNeighbours[tips[c]][myChoices[c]];
+			const PairRelationship * pr = next.pr;
+			newIds[c] = next.nodeId;
+
+			for (int i = 0; i < 3; i++)
+			{
+				const float * r = &pr->rot.rows[i].x;
+				const float * ri = &pr->rotInv.rows[i].x;
+				for (int k = 0; k < 3; k++)
+				{
+					rot[i * 3 + k][c] = r[k];
+					rotInv[i * 3 + k][c] = ri[k];
+				}
+			}
+			tran[0][c] = pr->tran.x;
+			tran[1][c] = pr->tran.y;
+			tran[2][c] = pr->tran.z;
+		}
+
+		#pragma omp simd
+		for (uint c = 0; c < n; c++)
+		{
+			// tipToWorld = inverse(rotInv, tran).then(tipToWorld)
+			double invTran[3];
+			for (int k = 0; k < 3; k++)
+				invTran[k] = -(tran[0][c] * rotInv[k][c] +
+				               tran[1][c] * rotInv[3 + k][c] +
+				               tran[2][c] * rotInv[6 + k][c]);
+
+			double a[CHAIN_BATCH_FRAME];
+			for (int k = 0; k < 3; k++)
+			{
+				for (int i = 0; i < 3; i++)
+					a[i * 3 + k] = rotInv[i * 3][c] * t2w[k][c] +
+					               rotInv[i * 3 + 1][c] * t2w[3 + k][c] +
+					               rotInv[i * 3 + 2][c] * t2w[6 + k][c];
+
+				a[FRAME_TRAN + k] = invTran[0] * t2w[k][c] +
+				                    invTran[1] * t2w[3 + k][c] +
+				                    invTran[2] * t2w[6 + k][c] +
+				                    t2w[FRAME_TRAN + k][c];
+			}
+
+			// worldToTip = worldToTip.then(RigidTransform(rot, tran))
+			double b[CHAIN_BATCH_FRAME];
+			for (int k = 0; k < 3; k++)
+			{
+				for (int i = 0; i < 3; i++)
+					b[i * 3 + k] = w2t[i * 3][c] * rot[k][c] +
+					               w2t[i * 3 + 1][c] * rot[3 + k][c] +
+					               w2t[i * 3 + 2][c] * rot[6 + k][c];
+
+				b[FRAME_TRAN + k] = w2t[FRAME_TRAN][c] * rot[k][c] +
+				                    w2t[FRAME_TRAN + 1][c] * rot[3 + k][c] +
+				                    w2t[FRAME_TRAN + 2][c] * rot[6 + k][c] +
+				                    tran[k][c];
+			}
+
+			for (int k = 0; k < CHAIN_BATCH_FRAME; k++)
+			{
+				t2w[k][c] = a[k];
+				w2t[k][c] = b[k];
+			}
+		}
+
+		float * xs = &myXs[myLen * LANES];
+		float * ys = &myYs[myLen * LANES];
+		float * zs = &myZs[myLen * LANES];
+		float * rs = &myRadii[myLen * LANES];
+		for (uint c = 0; c < n; c++)
+		{
+			xs[c] = t2w[FRAME_TRAN][c];
+			ys[c] = t2w[FRAME_TRAN + 1][c];
+			zs[c] = t2w[FRAME_TRAN + 2][c];
+			rs[c] = radii[newIds[c]];
+		}
+
+		myLen++;
+	}
+}
+
+template <typename T>
+static void
+permuteRow(T * row, const uint * order, const uint count)
+{
+	T moved[LANES];
+	for (uint c = 0; c < count; c++)
+		moved[c] = row[order[c]];
+	std::copy(moved, moved + count, row);
+}
+
+void
+ChainBatch::sortLanes()
+{
+	const std::vector<WeightedNeighbours> & allNeighbours = Chromosome::myRhsNeighbours;
+	const uint * tips = &myIds[(myLen - 1) * LANES];
+
+	bool sorted = true;
+	uint maxDegree = 0;
+	for (uint c = 0; c < myLanes; c++)
+	{
+		myDegrees[c] = allNeighbours[tips[c]].size();
+		maxDegree = std::max(maxDegree, myDegrees[c]);
+		sorted = sorted && (c == 0 || myDegrees[c] <= myDegrees[c - 1]);
+	}
+
+	if (sorted)
+		return;
+
+	// Counting sort; starts[d] is where lanes of degree d go
+	std::vector<uint> & starts = myDegreeStarts;
+	starts.assign(maxDegree + 2, 0);
+	for (uint c = 0; c < myLanes; c++)
+		starts[maxDegree - myDegrees[c] + 1]++;
+	for (uint d = 1; d <= maxDegree + 1; d++)
+		starts[d] += starts[d - 1];
+
+	uint order[LANES];
+	for (uint c = 0; c < myLanes; c++)
+		order[starts[maxDegree - myDegrees[c]]++] = c;
+
+	// Rows are contiguous by lane, so each is permuted in
+	// place of its own
+	for (uint g = 0; g < myLen; g++)
+	{
+		permuteRow(&myIds[g * LANES], order, myLanes);
+		permuteRow(&myXs[g * LANES], order, myLanes);
+		permuteRow(&myYs[g * LANES], order, myLanes);
+		permuteRow(&myZs[g * LANES], order, myLanes);
+		permuteRow(&myRadii[g * LANES], order, myLanes);
+	}
+
+	for (int k = 0; k < CHAIN_BATCH_FRAME; k++)
+	{
+		permuteRow(myTipToWorld[k], order, myLanes);
+		permuteRow(myWorldToTip[k], order, myLanes);
+	}
+
+	permuteRow(mySlots, order, myLanes);
+	permuteRow(myDegrees, order, myLanes);
+}
+
+void
+ChainBatch::retire(const uint lane)
+{
+	if (myLen < Chromosome::myMinLen)
+	{
+		myRejected.push_back(mySlots[lane]);
+	}
+	else
+	{
+		Chromosome & chromo = *myChromos[mySlots[lane]];
+		Chromosome::Expansion expansion(chromo, false);
+		Genes & genes = chromo.myGenes;
+		genes.clear();
+
+		KabschTracker tracker(Chromosome::myIncrementalCtx);
+		KabschTracker * trk = Chromosome::myIncrementalCtx ? &tracker : NULL;
+		if (trk)
+			trk->reset();
+
+		const double (* const w2t)[LANES] = myWorldToTip;
+		for (uint g = 0; g < myLen; g++)
+		{
+			const size_t at = g * LANES + lane;
+			const Point3f world(myXs[at], myYs[at], myZs[at]);
+			if (trk)
+				trk->append(world);
+
+			// Into the tip's frame, as RigidTransform::apply()
+			double tip[3];
+			for (int k = 0; k < 3; k++)
+				tip[k] = world.x * w2t[k][lane] +
+				         world.y * w2t[3 + k][lane] +
+				         world.z * w2t[6 + k][lane] +
+				         w2t[FRAME_TRAN + k][lane];
+
+			genes.emplace_back(myIds[at], Point3f(tip[0], tip[1], tip[2]));
+		}
+
+		chromo.invalidateScore();
+		chromo.scoreFromTracker(trk);
+		chromo.setOrigin(Origin::Random);
+	}
+
+	myLanes--;
+	if (lane != myLanes)
+		moveLane(myLanes, lane);
+}
+
+void
+ChainBatch::moveLane(const uint from, const uint to)
+{
+	for (uint g = 0; g < myLen; g++)
+	{
+		myIds[g * LANES + to] = myIds[g * LANES + from];
+		myXs[g * LANES + to] = myXs[g * LANES + from];
+		myYs[g * LANES + to] = myYs[g * LANES + from];
+		myZs[g * LANES + to] = myZs[g * LANES + from];
+		myRadii[g * LANES + to] = myRadii[g * LANES + from];
+	}
+
+	for (int k = 0; k < CHAIN_BATCH_FRAME; k++)
+	{
+		myTipToWorld[k][to] = myTipToWorld[k][from];
+		myWorldToTip[k][to] = myWorldToTip[k][from];
+	}
+
+	mySlots[to] = mySlots[from];
+	myChoices[to] = myChoices[from];
+}
+
+ChainBatch &
+getChainBatch()
+{
+	static thread_local ChainBatch batch;
+	return batch;
+}
+
+int _testChainBatch()
+{
+	msg("Testing ChainBatch\n");
+
+	int failCount = 0;
+
+	// More chromosomes than lanes, so that lanes are filled
+	// more than once
+	const uint count = 2 * LANES + 37;
+	std::vector<Chromosome> chromos(count);
+	getChainBatch().randomise(chromos.data(), chromos.size());
+
+	uint minSeen = -1, maxSeen = 0;
+	for (auto & chromo : chromos)
+	{
+		const Genes & genes = chromo.genes();
+		minSeen = std::min(minSeen, (uint) genes.size());
+		maxSeen = std::max(maxSeen, (uint) genes.size());
+
+		if (chromo.getOrigin() != Origin::Random || chromo.scoreValid())
+		{
+			failCount++;
+			err("Batch chain has origin %s and a valid score\n",
+			    OriginString[chromo.getOrigin()]);
+		}
+
+		if (genes.size() < Chromosome::minLen() || genes.size() > Chromosome::maxLen())
+		{
+			failCount++;
+			err("Batch chain of length %lu is out of bounds\n", genes.size());
+			continue;
+		}
+
+		// Batch chains must be chains synthesise() accepts,
+		// laid out where it puts them
+		Genes synthesised = genes;
+		if (!Chromosome::synthesise(synthesised))
+		{
+			failCount++;
+			err("Batch chain collides:\n%s\n", genesToString(genes).c_str());
+			continue;
+		}
+
+		for (int i = 0; i < genes.size(); i++)
+		{
+			if (!synthesised.at(i).com().approximates(genes.at(i).com(), 1e-2))
+			{
+				failCount++;
+				err("Batch gene %d at %s but synthesised at %s\n",
+				    i,
+				    genes.at(i).com().toString().c_str(),
+				    synthesised.at(i).com().toString().c_str());
+				break;
+			}
+		}
+	}
+
+	if (minSeen == maxSeen)
+	{
+		failCount++;
+		err("Every batch chain has length %u\n", minSeen);
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
+int _benchChainBatch()
+{
+	msg("Benchmarking random chains: Chromosome::randomise() vs ChainBatch\n");
+
+	setupBenchChromosome(100);
+
+	const uint count = 32 * LANES;
+	std::vector<Chromosome> chromos(count);
+
+	double t0 = get_timestamp_us();
+	ulong scalarGenes = 0;
+	for (auto & chromo : chromos)
+	{
+		chromo.randomise();
+		scalarGenes += chromo.genes().size();
+	}
+	const double scalarTime = get_timestamp_us() - t0;
+
+	t0 = get_timestamp_us();
+	getChainBatch().randomise(chromos.data(), chromos.size());
+	const double batchTime = get_timestamp_us() - t0;
+
+	ulong batchGenes = 0;
+	for (const auto & chromo : chromos)
+		batchGenes += chromo.genes().size();
+
+	msg("%u chains: randomise() %.2fus/chain (%.1f genes), batch %.2fus/chain (%.1f genes) (%.2fx)\n",
+	    count,
+	    scalarTime / count,
+	    (float) scalarGenes / count,
+	    batchTime / count,
+	    (float) batchGenes / count,
+	    scalarTime / batchTime);
+
+	return 0;
+}
+
+} // namespace elfin
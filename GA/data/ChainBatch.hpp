@@ -0,0 +1,122 @@
+#ifndef _CHAINBATCH_HPP_
+#define _CHAINBATCH_HPP_
+
+#include <vector>
+
+#include "TypeDefs.hpp"
+#include "Chromosome.hpp"
+
+// Chains grown side by side by one ChainBatch
+#ifndef CHAIN_BATCH_LANES
+#define CHAIN_BATCH_LANES 256
+#endif
+
+// Entries of a frame kept per lane: a row-major rotation
+// followed by a translation, as in RigidTransform
+#define CHAIN_BATCH_FRAME 12
+
+namespace elfin
+{
+
+/*
+ * Grows random chains for many chromosomes in lockstep, each
+ * the way Chromosome::randomise() grows one. Every lane holds
+ * one chain, and coordinates are kept by gene then lane, so
+ * each step places the candidates and tests collisions of
+ * all lanes in the same loops. A lane that gets stuck is
+ * retired by moving the last live lane into its place.
+ *
+ * Candidates are tested against every earlier gene of their
+ * lane rather than through a CollisionGrid, with the radii of
+ * the measure CollisionGrid::setup() selected, except the
+ * gene three back, which is looked up in the ExclusionTable.
+ * Verdicts are those of the grid, and each lane draws its
+ * neighbours with the same weights as
+ * Chromosome::genRandomGenes().
+ */
+class ChainBatch
+{
+public:
+	// Gives every chromosome a new random chain; chains that
+	// end up shorter than the minimum length are regrown
+	void randomise(Chromosome * chromos, const size_t count);
+	void randomiseEach(Chromosome * const * chromos, const size_t count);
+
+private:
+	typedef Chromosome::WeightedNeighbours WeightedNeighbours;
+
+	// Neighbour j of a node, laid out for the growth step
+	struct Candidate
+	{
+		float x = 0.0f, y = 0.0f, z = 0.0f; // comB
+		float radius = 0.0f;
+		uint weight = 0;
+		uint reach = 0;
+	};
+
+	void buildCandidates();
+
+	// Starts one chain per slot, at most CHAIN_BATCH_LANES
+	void start(const uint * slots, const uint count);
+
+	// Grows all lanes until every one has been retired
+	void grow();
+
+	// Emits the chain of lane, or queues its slot again if
+	// the chain is too short, then fills the lane with the
+	// last live lane
+	void retire(const uint lane);
+
+	void moveLane(const uint from, const uint to);
+
+	// Orders live lanes by descending tip degree, so that
+	// the lanes whose tip has a j-th neighbour come first
+	void sortLanes();
+
+	// Indexed by node * myMaxDegree + j
+	std::vector<Candidate> myCandidates;
+	uint myMaxDegree = 0;
+
+	Chromosome * const * myChromos = NULL;
+	std::vector<uint> myRejected;
+
+	uint myLanes = 0; // Live lanes
+	uint myLen = 0;   // Genes in every live lane
+
+	// Indexed by gene * CHAIN_BATCH_LANES + lane; positions
+	// are in the frame of the first gene
+	std::vector<uint> myIds;
+	std::vector<float> myXs, myYs, myZs, myRadii;
+
+	// Indexed by lane
+	uint mySlots[CHAIN_BATCH_LANES];
+	int myChoices[CHAIN_BATCH_LANES];
+	uint myDegrees[CHAIN_BATCH_LANES]; // Neighbours of the tip
+	const char * myExcludedRows[CHAIN_BATCH_LANES]; // ExclusionTable::rhsRow()
+	double myTipToWorld[CHAIN_BATCH_FRAME][CHAIN_BATCH_LANES];
+	double myWorldToTip[CHAIN_BATCH_FRAME][CHAIN_BATCH_LANES];
+
+	// Candidate of each lane for one neighbour index
+	float myCandX[CHAIN_BATCH_LANES];
+	float myCandY[CHAIN_BATCH_LANES];
+	float myCandZ[CHAIN_BATCH_LANES];
+	float myCandRadii[CHAIN_BATCH_LANES];
+	uint myLive[CHAIN_BATCH_LANES];
+	uint myHits[CHAIN_BATCH_LANES];
+
+	// Roulette of each lane; entry j * CHAIN_BATCH_LANES +
+	// lane is the weight total up to neighbour j
+	std::vector<uint> myEnds;
+	uint myTotals[CHAIN_BATCH_LANES];
+	std::vector<uint> myDegreeStarts;
+};
+
+// Per-thread batch for population initialisation
+ChainBatch & getChainBatch();
+
+int _testChainBatch();
+int _benchChainBatch();
+
+} // namespace elfin
+
+#endif /* include guard */
@@ -6,10 +6,15 @@
 #include <tuple>
 
 #include "../core/MathUtils.hpp"
+#include "../core/CollisionGrid.hpp"
+#include "../core/ExclusionTable.hpp"
+#include "../core/SegmentSpheres.hpp"
 #include "../core/Kabsch.hpp"
 #include "../data/PairRelationship.hpp"
 #include "../input/JSONParser.hpp"
 #include "../core/ParallelUtils.hpp"
+#include "../core/BenchUtils.hpp"
+#include "../core/AllocCounter.hpp"
 
 namespace elfin
 {
@@ -21,7 +26,15 @@ uint Chromosome::myMaxLen = 0;
 const RelaMat * Chromosome::myRelaMat = NULL;
 const RadiiList * Chromosome::myRadiiList = NULL;
 IdPairs Chromosome::myNeighbourCounts;
-IdRoulette Chromosome::myGlobalRoulette;
+Roulette Chromosome::myGlobalRoulette;
+std::vector<Chromosome::WeightedNeighbours> Chromosome::myRhsNeighbours;
+std::vector<Chromosome::WeightedNeighbours> Chromosome::myLhsNeighbours;
+std::vector<uint> Chromosome::myRhsReach;
+std::vector<uint> Chromosome::myLhsReach;
+std::atomic<ulong> Chromosome::myRandomiseRejects(0);
+std::atomic<ulong> Chromosome::myLimbRegrowRetries(0);
+const SpecScoringContext * Chromosome::myIncrementalCtx = NULL;
+ScoreBackend Chromosome::myIncrementalBackend = ScoreBackend::Rosetta;
 
 // Constructors and Operators
 Chromosome::Chromosome()
@@ -31,8 +44,10 @@ Chromosome::Chromosome()
 
 Chromosome::Chromosome(const Chromosome & rhs)
 {
-	myGenes = rhs.myGenes;
-	myScore = rhs.myScore;
+	const Origin origin = myOrigin;
+	myCompact = rhs.myCompact;
+	assignFrom(rhs);
+	myOrigin = origin;
 }
 
 
@@ -42,6 +57,13 @@ Chromosome::Chromosome(const Genes & genes)
 	setOrigin(Origin::GeneCopy);
 }
 
+Chromosome &
+Chromosome::operator=(const Chromosome & rhs)
+{
+	assignFrom(rhs);
+	return *this;
+}
+
 bool
 Chromosome::operator>(const Chromosome & rhs) const
 {
@@ -59,7 +81,9 @@ Chromosome::operator<(const Chromosome & rhs) const
 void
 Chromosome::score(const Points3f & ref)
 {
-	myScore = kabschScore(myGenes, ref);
+	myScore = kabschScore(genes(), ref);
+	myScoreValid = true;
+	myScoreIsBound = false;
 }
 
 float
@@ -68,28 +92,82 @@ Chromosome::getScore() const
 	return myScore;
 }
 
+void
+Chromosome::setScore(const float score)
+{
+	myScore = score;
+	myScoreValid = true;
+	myScoreIsBound = false;
+}
+
+bool
+Chromosome::scoreValid() const
+{
+	return myScoreValid;
+}
+
+void
+Chromosome::invalidateScore()
+{
+	myScoreValid = false;
+	myScoreIsBound = false;
+}
+
+void
+Chromosome::setScoreBound(const float bound)
+{
+	myScore = bound;
+	myScoreValid = false;
+	myScoreIsBound = true;
+}
+
+bool
+Chromosome::scoreIsBound() const
+{
+	return myScoreIsBound;
+}
+
 Genes &
 Chromosome::genes()
 {
+	panic_if(idsOnly(), "Chromosome::genes(): compact genes can only be read\n");
+	invalidateScore();
 	return myGenes;
 }
 
 const Genes &
 Chromosome::genes() const
 {
-	return myGenes;
+	if (!idsOnly())
+		return myGenes;
+
+	static thread_local Genes placed;
+	placed.clear();
+	for (const CompactId id : myNodeIds)
+		placed.emplace_back(id);
+	placeValid(placed);
+
+	return placed;
+}
+
+uint
+Chromosome::length() const
+{
+	return idsOnly() ? myNodeIds.size() : myGenes.size();
 }
 
 Crc32
 Chromosome::checksum() const
 {
 	// Calculate lazily because it's only used once per
-	// generation
+	// generation. Node IDs determine the whole chain, and
+	// read the same in both representations
 	Crc32 crc = 0xffff;
-	for (int i = 0; i < myGenes.size(); i++)
+	const uint len = length();
+	for (uint i = 0; i < len; i++)
 	{
-		const Point3f & pt = myGenes.at(i).com();
-		checksumCascade(&crc, &pt, sizeof(pt));
+		const uint id = nodeIdAt(i);
+		checksumCascade(&crc, &id, sizeof(id));
 	}
 
 	return crc;
@@ -100,8 +178,9 @@ Chromosome::getNodeNames() const
 {
 	std::vector<std::string> out;
 
-	for (const auto & gene : myGenes)
-		out.push_back(Gene::inm->at(gene.nodeId()));
+	const uint len = length();
+	for (uint i = 0; i < len; i++)
+		out.push_back(Gene::inm->at(nodeIdAt(i)));
 
 	return out;
 }
@@ -112,7 +191,7 @@ Chromosome::toString() const
 	std::stringstream ss;
 
 	ss << "Chromosome " << this << ":\n";
-	ss << genesToString(myGenes);
+	ss << genesToString(genes());
 
 	return ss.str();
 }
@@ -124,9 +203,9 @@ Chromosome::cross(const Chromosome & father, Chromosome & out) const
 
 	IdPairs crossingIds;
 
-	const Genes & fatherG = father.genes();
-	const uint fgLen = fatherG.size();
-	const uint mgLen = myGenes.size();
+	// Only node IDs are needed, so neither parent is placed
+	const uint fgLen = father.length();
+	const uint mgLen = length();
 
 	// In below comments gene1 = this, gene2 = other
 	for (int i = 0; i < mgLen; i++)
@@ -146,7 +225,7 @@ Chromosome::cross(const Chromosome & father, Chromosome & out) const
 			                      (uint) fgLen - 1);
 			for (int j = minJ; j < maxJ; j++)
 			{
-				if (myGenes.at(i).nodeId() == fatherG.at(j).nodeId())
+				if (nodeIdAt(i) == father.nodeIdAt(j))
 				{
 
 #ifdef _TEST_CHROMO
@@ -176,22 +255,27 @@ Chromosome::cross(const Chromosome & father, Chromosome & out) const
 			const uint motherGeneId = crossPoint.x;
 			const uint fatherGeneId = crossPoint.y;
 
-			const Genes & motherG = myGenes;
-			const Genes & fatherG = father.genes();
-
-			Genes newGenes;
-			newGenes.insert(newGenes.end(), motherG.begin(), motherG.begin() + motherGeneId);
-			newGenes.insert(newGenes.end(), fatherG.begin() + fatherGeneId, fatherG.end());
+			// Only copied into out if the child is valid
+			static thread_local Genes newGenes;
+			newGenes.clear();
+			for (uint k = 0; k < motherGeneId; k++)
+				newGenes.emplace_back(nodeIdAt(k));
+			for (uint k = fatherGeneId; k < fgLen; k++)
+				newGenes.emplace_back(father.nodeIdAt(k));
 
 			// dbg("Crossing at mother[%d] and father[%d]\n", motherGeneId, fatherGeneId);
 			// dbg("Mother: \n%s\n", mother.toCString());
 			// dbg("Father: \n%s\n", father.toCString());
 			// dbg("New Genes: \n%s\n", genesToString(newGenes).c_str());
 
-			if (synthesise(newGenes))
+			KabschTracker tracker(myIncrementalCtx);
+			KabschTracker * trk = myIncrementalCtx ? &tracker : NULL;
+			if (synthesiseSplice(newGenes, motherGeneId, trk))
 			{
-				out = Chromosome(newGenes);
+				out.storeGenes(newGenes);
+				out.invalidateScore();
 				out.setOrigin(Origin::Cross);
+				out.scoreFromTracker(trk);
 				return true;
 			}
 		}
@@ -200,14 +284,12 @@ Chromosome::cross(const Chromosome & father, Chromosome & out) const
 	return false;
 }
 
-Chromosome
-Chromosome::mutateChild() const
+void
+Chromosome::mutateChild(Chromosome & out) const
 {
-	Chromosome out = *this;
+	out = *this;
 	out.autoMutate();
 	out.setOrigin(Origin::AutoMutate);
-
-	return out;
 }
 
 void
@@ -231,11 +313,19 @@ Chromosome::autoMutate()
 void
 Chromosome::randomise()
 {
-	do
+	Expansion expansion(*this, false);
+
+	KabschTracker tracker(myIncrementalCtx);
+	KabschTracker * trk = myIncrementalCtx ? &tracker : NULL;
+	while (true)
 	{
-		myGenes = genRandomGenes();
+		myGenes = genRandomGenes(myMaxLen, Genes(), trk);
+		if (myGenes.size() >= myMinLen && myGenes.size() <= myMaxLen)
+			break;
+		myRandomiseRejects.fetch_add(1, std::memory_order_relaxed);
 	}
-	while (myGenes.size() < myMinLen || myGenes.size() > myMaxLen);
+	invalidateScore();
+	scoreFromTracker(trk);
 	setOrigin(Origin::Random);
 }
 
@@ -263,10 +353,32 @@ Chromosome::pointMutate()
 	// 3. Delete the node
 	// As of now it uses equal probability.
 	// Could be opened up as a setting.
+	Expansion expansion(*this);
+
 	const size_t dim = myRelaMat->size();
 	const size_t myGeneSize = myGenes.size();
 	std::vector<PointMutateMode> modes(pmModeArr,
 	                                   pmModeArr + sizeof(pmModeArr) / sizeof(pmModeArr[0]));
+	KabschTracker tracker(myIncrementalCtx);
+	KabschTracker * trk = myIncrementalCtx ? &tracker : NULL;
+
+	// Candidates are tested against one placement of the
+	// current genes
+	PointMutateScan & scan = getPointMutateScan();
+	scan.reset(myGenes);
+
+	// Picks are synthesised in scratch, so that myGenes keeps
+	// its placement unless one of them succeeds
+	static thread_local Genes trial;
+	auto synthesiseTrial = [this, trk]() {
+		if (!synthesise(trial, trk))
+			return false;
+
+		myGenes.swap(trial);
+		invalidateScore();
+		scoreFromTracker(trk);
+		return true;
+	};
 
 	while (modes.size() > 0)
 	{
@@ -275,7 +387,11 @@ Chromosome::pointMutate()
 		const PointMutateMode pmMode = modes.at(modeIndex);
 		modes.erase(modes.begin() + modeIndex);
 
-		// Try to perform the pointMutate in the chosen mode
+		// Try to perform the pointMutate in the chosen mode.
+		// The scan can only disagree with synthesise() by
+		// rounding right at a collision distance, so a pick
+		// that fails to synthesise is dropped and another one
+		// drawn
 		switch (pmMode)
 		{
 		case PointMutateMode::SwapMode: // Swap mode
@@ -305,12 +421,7 @@ Chromosome::pointMutate()
 						)
 						{
 							// Make sure resultant shape won't collide with itself
-							Genes testGenes(myGenes);
-							testGenes.at(i).nodeId() = j;
-
-							// dbg("checking swap at %d/%d of %s\n",
-							//     i, myGeneSize, toString().c_str());
-							if (synthesise(testGenes))
+							if (scan.canSwap(i, j))
 								swappableIds.push_back(IdPair(i, j));
 						}
 					}
@@ -318,14 +429,20 @@ Chromosome::pointMutate()
 			}
 
 			// Pick a random one, or fall through to next case
-			if (swappableIds.size() > 0)
+			while (swappableIds.size() > 0)
 			{
-				const IdPair & ids = swappableIds.at(getDice(swappableIds.size()));
-				myGenes.at(ids.x).nodeId() = ids.y;
+				const int pick = getDice(swappableIds.size());
+				const IdPair ids = swappableIds.at(pick);
+				trial = myGenes;
+				trial.at(ids.x).nodeId() = ids.y;
 
-				synthesise(myGenes); // This is guaranteed to succeed
-				setOrigin(Origin::PointMutate);
-				return true;
+				if (synthesiseTrial())
+				{
+					setOrigin(Origin::PointMutate);
+					return true;
+				}
+
+				swappableIds.erase(swappableIds.begin() + pick);
 			}
 		}
 
@@ -348,27 +465,25 @@ Chromosome::pointMutate()
 						)
 						{
 							// Make sure resultant shape won't collide with itself
-							Genes testGenes(myGenes);
-							testGenes.insert(testGenes.begin() + i, //This is insertion before i
-							                 Gene(j));
-
-							// dbg("checking insertion at %d/%d of %s\n",
-							//     i, myGeneSize, toString().c_str());
-							if (synthesise(testGenes))
+							if (scan.canInsert(i, j))
 								insertableIds.push_back(IdPair(i, j));
 						}
 					}
 				}
 
 				// Pick a random one, or fall through to next case
-				if (insertableIds.size() > 0)
+				while (insertableIds.size() > 0)
 				{
-					const IdPair & ids = insertableIds.at(getDice(insertableIds.size()));
-					myGenes.insert(myGenes.begin() + ids.x, //This is insertion before i
-					               Gene(ids.y));
+					const int pick = getDice(insertableIds.size());
+					const IdPair ids = insertableIds.at(pick);
+					trial = myGenes;
+					trial.insert(trial.begin() + ids.x, //This is insertion before i
+					             Gene(ids.y));
 
-					synthesise(myGenes); // This is guaranteed to succeed
-					return true;
+					if (synthesiseTrial())
+						return true;
+
+					insertableIds.erase(insertableIds.begin() + pick);
 				}
 			}
 		}
@@ -389,22 +504,23 @@ Chromosome::pointMutate()
 					)
 					{
 						// Make sure resultant shape won't collide with itself
-						Genes testGenes(myGenes);
-						testGenes.erase(testGenes.begin() + i);
-
-						// dbg("checking deletion at %d/%d of %s\n",
-						//     i, myGeneSize, toString().c_str());
-						if (synthesise(testGenes)) deletableIds.push_back(i);
+						if (scan.canDelete(i))
+							deletableIds.push_back(i);
 					}
 				}
 
 				// Pick a random one, or report impossible
-				if (deletableIds.size() > 0)
+				while (deletableIds.size() > 0)
 				{
-					myGenes.erase(myGenes.begin() + deletableIds.at(getDice(deletableIds.size())));
+					const int pick = getDice(deletableIds.size());
+					const uint i = deletableIds.at(pick);
+					trial = myGenes;
+					trial.erase(trial.begin() + i);
 
-					synthesise(myGenes); // This is guaranteed to succeed
-					return true;
+					if (synthesiseTrial())
+						return true;
+
+					deletableIds.erase(deletableIds.begin() + pick);
 				}
 			}
 		}
@@ -425,6 +541,8 @@ Chromosome::pointMutate()
 bool
 Chromosome::limbMutate()
 {
+	Expansion expansion(*this);
+
 	const size_t N = myGenes.size();
 
 	// Pick a node that can host an alternative limb
@@ -456,6 +574,7 @@ Chromosome::limbMutate()
 		return false;
 
 	// Server the limb
+	invalidateScore();
 	if (mutateLeftLimb)
 		myGenes.erase(myGenes.begin(), myGenes.begin() + severId);
 	else
@@ -463,26 +582,96 @@ Chromosome::limbMutate()
 
 	const uint severedLen = N - myGenes.size();
 
-	// Re-generate that whole "limb"
+	// Re-generate that whole "limb". Only right limbs grow
+	// in spec order, so only they can be tracked
+	KabschTracker tracker(myIncrementalCtx);
+	KabschTracker * trk = (myIncrementalCtx && !mutateLeftLimb) ? &tracker : NULL;
 	Genes newGenes;
 	for (int i = 0; i < MAX_STOCHASTIC_FAILS; i++)
 	{
 		newGenes = mutateLeftLimb ?
 		           genRandomGenesReverse(myMaxLen, myGenes) :
-		           genRandomGenes(myMaxLen, myGenes);
+		           genRandomGenes(myMaxLen, myGenes, trk);
 
 		if (newGenes.size() >= myMinLen)
 			break;
+		myLimbRegrowRetries.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	if (newGenes.size() < myMinLen)
 		return false;
 
 	myGenes = newGenes;
+	scoreFromTracker(trk);
 	setOrigin(Origin::LimbMutate);
 	return true;
 }
 
+void
+Chromosome::scoreFromTracker(const KabschTracker * tracker)
+{
+	// Only length-matched chains pair every spec point
+	if (tracker && tracker->complete())
+		setScore(tracker->score(myIncrementalBackend));
+}
+
+bool
+Chromosome::idsOnly() const
+{
+	return myCompact && !myExpanded;
+}
+
+uint
+Chromosome::nodeIdAt(const uint i) const
+{
+	return idsOnly() ? myNodeIds[i] : myGenes[i].nodeId();
+}
+
+void
+Chromosome::assignFrom(const Chromosome & rhs)
+{
+	if (this == &rhs)
+		return;
+
+	if (idsOnly())
+	{
+		if (rhs.idsOnly())
+		{
+			myNodeIds = rhs.myNodeIds;
+		}
+		else
+		{
+			myNodeIds.clear();
+			for (const auto & g : rhs.myGenes)
+				myNodeIds.push_back(g.nodeId());
+		}
+	}
+	else
+	{
+		myGenes = rhs.genes();
+	}
+
+	myScore = rhs.myScore;
+	myScoreValid = rhs.myScoreValid;
+	myScoreIsBound = rhs.myScoreIsBound;
+	myOrigin = rhs.myOrigin;
+}
+
+void
+Chromosome::storeGenes(const Genes & genes)
+{
+	if (idsOnly())
+	{
+		myNodeIds.clear();
+		for (const auto & g : genes)
+			myNodeIds.push_back(g.nodeId());
+	}
+	else
+	{
+		myGenes = genes;
+	}
+}
+
 void
 Chromosome::setOrigin(Origin o)
 {
@@ -495,19 +684,65 @@ Chromosome::getOrigin() const
 	return myOrigin;
 }
 
-Chromosome
-Chromosome::copy() const
+void
+Chromosome::copy(Chromosome & out) const
+{
+	out = *this;
+	out.setOrigin(Origin::Copy);
+}
+
+void
+Chromosome::swap(Chromosome & rhs)
+{
+	myGenes.swap(rhs.myGenes);
+	myNodeIds.swap(rhs.myNodeIds);
+	std::swap(myCompact, rhs.myCompact);
+	std::swap(myExpanded, rhs.myExpanded);
+	std::swap(myScore, rhs.myScore);
+	std::swap(myScoreValid, rhs.myScoreValid);
+	std::swap(myScoreIsBound, rhs.myScoreIsBound);
+	std::swap(myOrigin, rhs.myOrigin);
+}
+
+void
+Chromosome::setCompact(const bool compact)
+{
+	if (compact == myCompact)
+		return;
+
+	panic_if(compact && myRelaMat->size() > 256,
+	         "Chromosome::setCompact(): %lu node IDs do not fit one byte\n",
+	         myRelaMat->size());
+
+	// Through a copy, so that the chain moves over to the new
+	// representation
+	Chromosome old(*this);
+	myCompact = compact;
+	assignFrom(old);
+
+	if (compact)
+	{
+		Genes().swap(myGenes);
+		myNodeIds.reserve(myMaxLen);
+	}
+	else
+	{
+		std::vector<CompactId>().swap(myNodeIds);
+	}
+}
+
+bool
+Chromosome::compact() const
 {
-	Chromosome c = *this;
-	c.setOrigin(Origin::Copy);
-	return c;
+	return myCompact;
 }
 
 void
 Chromosome::setup(const uint minLen,
                   const uint maxLen,
                   const RelaMat & relaMat,
-                  const RadiiList & radiiList)
+                  const RadiiList & radiiList,
+                  const CollisionMeasure measure)
 {
 	if (setupDone)
 		die("Chromosome::setup() called second time!\n");
@@ -516,6 +751,8 @@ Chromosome::setup(const uint minLen,
 	myMaxLen = maxLen;
 	myRelaMat = &relaMat;
 	myRadiiList = &radiiList;
+	CollisionGrid::setup(radiiList, measure);
+	ExclusionTable::setup(relaMat, CollisionGrid::nodeRadii());
 
 	// Compute neighbour counts
 	const uint dim = myRelaMat->size();
@@ -534,15 +771,113 @@ Chromosome::setup(const uint minLen,
 		myNeighbourCounts.at(i) = IdPair(lhs, rhs);
 	}
 
-	// Compute global roulette as rhs neighbour count
+	// Growth rolls among the neighbours of the tip, weighted
+	// like the global roulette
+	myRhsNeighbours.assign(dim, WeightedNeighbours());
+	myLhsNeighbours.assign(dim, WeightedNeighbours());
+	for (int i = 0; i < dim; i++)
+	{
+		for (int j = 0; j < dim; j++)
+		{
+			const PairRelationship * rhsPr = myRelaMat->at(i).at(j);
+			if (rhsPr != NULL)
+				myRhsNeighbours.at(i).push_back({(uint) j, (uint) myNeighbourCounts.at(j).y, rhsPr});
+
+			const PairRelationship * lhsPr = myRelaMat->at(j).at(i);
+			if (lhsPr != NULL)
+				myLhsNeighbours.at(i).push_back({(uint) j, (uint) myNeighbourCounts.at(j).x, lhsPr});
+		}
+	}
+
+	myRhsReach = calcReach(myRhsNeighbours, myMinLen);
+	myLhsReach = calcReach(myLhsNeighbours, myMinLen);
+
+	// Compute global roulette as rhs neighbour count, over
+	// nodes that can start a chain of minimum length
 	myGlobalRoulette.clear();
 	for (int i = 0; i < dim; i++)
-		for (int j = 0; j < myNeighbourCounts.at(i).y; j++)
-			myGlobalRoulette.push_back(i);
+		if (myRhsReach.at(i) + 1 >= myMinLen)
+			myGlobalRoulette.add(i, myNeighbourCounts.at(i).y);
+
+	panic_if(myGlobalRoulette.empty(),
+	         "No chain of %u modules is possible in the database\n", myMinLen);
 
 	setupDone = true;
 }
 
+/*
+ * Most modules a chain can still be extended by after each
+ * node, following neighbours, capped at cap. Every pass
+ * lengthens the paths considered by one, so cap passes are
+ * enough; nodes that lead into a cycle end at cap.
+ */
+std::vector<uint>
+Chromosome::calcReach(
+    const std::vector<WeightedNeighbours> & neighbours,
+    const uint cap)
+{
+	std::vector<uint> reach(neighbours.size(), 0);
+
+	for (int pass = 0; pass < cap; pass++)
+	{
+		bool changed = false;
+		for (int i = 0; i < neighbours.size(); i++)
+		{
+			for (const auto & nb : neighbours.at(i))
+			{
+				const uint r = std::min(reach.at(nb.nodeId) + 1, cap);
+				if (r > reach.at(i))
+				{
+					reach.at(i) = r;
+					changed = true;
+				}
+			}
+		}
+
+		if (!changed)
+			break;
+	}
+
+	return reach;
+}
+
+uint
+Chromosome::minLen()
+{
+	return myMinLen;
+}
+
+uint
+Chromosome::maxLen()
+{
+	return myMaxLen;
+}
+
+ulong
+Chromosome::randomiseRejects()
+{
+	return myRandomiseRejects.load(std::memory_order_relaxed);
+}
+
+ulong
+Chromosome::limbRegrowRetries()
+{
+	return myLimbRegrowRetries.load(std::memory_order_relaxed);
+}
+
+/*
+ * Let synthesis and forward growth maintain Kabsch
+ * statistics so that chromosomes whose length matches the
+ * spec are scored as a by-product of being built
+ */
+void
+Chromosome::setupIncrementalScoring(const SpecScoringContext * ctx,
+                                    const ScoreBackend backend)
+{
+	myIncrementalCtx = ctx;
+	myIncrementalBackend = backend;
+}
+
 /*
  * Calculate expected length as total point
  * displacements over avg pair module distance
@@ -565,192 +900,390 @@ Chromosome::calcExpectedLength(const Points3f & lenRef,
 	return (uint) round(sumDist / avgPairDist) + 1; // Add one because start and end
 }
 
-bool
-Chromosome::synthesiseReverse(Genes & genes)
+/*
+ * Frames of a chain while it grows. Every gene is placed
+ * once, in the frame the first gene was placed in (the world
+ * frame), instead of moving every earlier gene as the tip
+ * advances. tipToWorld maps the frame of the growth tip into
+ * the world frame; worldToTip composes the same per-step
+ * transforms the old per-gene updates applied, so that the
+ * finished chain ends up in the frame of its tip as before.
+ */
+struct Chromosome::GrowthFrames
 {
-	const uint N = genes.size();
-	if (N == 0)
-		return true;
+	RigidTransform tipToWorld;
+	RigidTransform worldToTip;
 
-	// Zero all coords so they don't interfere with
-	// collision check before being synth'd
-	for (auto & g : genes)
-		g.com().x = (g.com().y = (g.com().z = 0));
-
-	for (int i = N - 1; i > 0; i--)
+	// Tip moves from A to B of pr; in tip coordinates,
+	// earlier genes move x -> x.dot(rot) + tran
+	void growForward(const PairRelationship * pr)
 	{
-		const auto & lhsGene = genes.at(i - 1);
-		const auto & rhsGene = genes.at(i);
-
-		// Check collision
-		const PairRelationship * newNodePr =
-		    myRelaMat->at(lhsGene.nodeId()).at(rhsGene.nodeId());
-
-		if (newNodePr == NULL)
-		{
-			// Fatal failure; diagnose!
-			err("Synthesise(): impossible pair! %d(%s) <-x-> %d(%s)\n",
-			    lhsGene.nodeId(),
-			    Gene::inm->at(lhsGene.nodeId()).c_str(),
-			    rhsGene.nodeId(),
-			    Gene::inm->at(rhsGene.nodeId()).c_str());
+		tipToWorld = RigidTransform::inverse(pr->rotInv, pr->tran).then(tipToWorld);
+		worldToTip = worldToTip.then(RigidTransform(pr->rot, pr->tran));
+	}
 
-			err("Erroneous genes:\n%s\n", genesToString(genes).c_str());
+	// Tip moves from B to A of pr; in tip coordinates,
+	// earlier genes move x -> (x - tran).dot(rotInv)
+	void growReverse(const PairRelationship * pr)
+	{
+		tipToWorld = RigidTransform(pr->rot, pr->tran).then(tipToWorld);
+		worldToTip = worldToTip.then(RigidTransform::inverse(pr->rotInv, pr->tran));
+	}
 
+	void toTipFrame(Genes & genes) const
+	{
+		for (auto & g : genes)
+			g.com() = worldToTip.apply(g.com());
+	}
+};
 
-			die("Fatal error in synthesiseReverse(): should never use impossible pair\n");
-		}
+static const PairRelationship *
+checkedPair(const RelaMat & relaMat,
+            const Genes & genes,
+            const uint lhsIndex,
+            const char * caller)
+{
+	const auto & lhsGene = genes.at(lhsIndex);
+	const auto & rhsGene = genes.at(lhsIndex + 1);
+	const PairRelationship * pr =
+	    relaMat.at(lhsGene.nodeId()).at(rhsGene.nodeId());
 
-		const Point3f checkpoint = newNodePr->tran;
+	if (pr == NULL)
+	{
+		// Fatal failure; diagnose!
+		err("Synthesise(): impossible pair! %d(%s) <-x-> %d(%s)\n",
+		    lhsGene.nodeId(),
+		    Gene::inm->at(lhsGene.nodeId()).c_str(),
+		    rhsGene.nodeId(),
+		    Gene::inm->at(rhsGene.nodeId()).c_str());
 
-		if (collides(lhsGene.nodeId(),
-		             checkpoint,
-		             genes.begin() + i + 2,
-		             genes.end(),
-		             *myRadiiList))
-			return false;
+		err("Erroneous genes:\n%s\n", genesToString(genes).c_str());
 
-		// Grow shape
-		for (int j = N - 1; j > i - 1; j--)
-		{
-			auto & g = genes.at(j);
-			g.com() -= newNodePr->tran;
-			g.com() = g.com().dot(newNodePr->rotInv);
-		}
+		die("Fatal error in %s(): should never use impossible pair\n", caller);
 	}
 
-	return true;
+	return pr;
 }
 
+/*
+ * Places genes in the world frame of frames, first gene at
+ * the origin, filling the thread's collision grid and
+ * tracker (if any) as it goes. Stops at the first collision,
+ * unless check is false for genes known not to collide.
+ */
 bool
-Chromosome::synthesise(Genes & genes)
+Chromosome::placeGenes(Genes & genes,
+                       GrowthFrames & frames,
+                       KabschTracker * tracker,
+                       const bool check)
 {
-	if (genes.size() == 0)
-		return true;
+	CollisionGrid & grid = getCollisionGrid();
+	grid.reset();
 
-	// Zero all coords so they don't interfere with
-	// collision check before being synth'd
-	for (auto & g : genes)
-		g.com().x = (g.com().y = (g.com().z = 0));
+	genes.at(0).com() = Point3f(0, 0, 0);
+	grid.insert(0, genes.at(0));
 
-	for (int i = 1; i < genes.size(); i++)
+	if (tracker)
 	{
-		const auto & lhsGene = genes.at(i - 1);
-		const auto & rhsGene = genes.at(i);
+		tracker->reset();
+		tracker->append(genes.at(0).com());
+	}
 
-		// Check collision
+	for (int i = 1; i < genes.size(); i++)
+	{
 		const PairRelationship * newNodePr =
-		    myRelaMat->at(lhsGene.nodeId()).at(rhsGene.nodeId());
-
-		if (newNodePr == NULL)
-		{
-			// Fatal failure; diagnose!
-			err("Synthesise(): impossible pair! %d(%s) <-x-> %d(%s)\n",
-			    lhsGene.nodeId(),
-			    Gene::inm->at(lhsGene.nodeId()).c_str(),
-			    rhsGene.nodeId(),
-			    Gene::inm->at(rhsGene.nodeId()).c_str());
-
-			err("Erroneous genes:\n%s\n", genesToString(genes).c_str());
+		    checkedPair(*myRelaMat, genes, i - 1, "synthesise");
 
-			die("Fatal error in synthesise(): should never use impossible pair\n");
-		}
+		// Check collision; the gene three back is looked up
+		if (check && i >= 3 && ExclusionTable::excluded(genes.at(i - 3).nodeId(),
+		                                                genes.at(i - 2).nodeId(),
+		                                                genes.at(i - 1).nodeId(),
+		                                                genes.at(i).nodeId()))
+			return false;
 
-		if (collides(rhsGene.nodeId(),
-		             newNodePr->comB,
-		             genes.begin(),
-		             genes.begin() + i - 2,
-		             *myRadiiList))
+		if (check && grid.collides(genes.at(i).nodeId(),
+		                           frames.tipToWorld.apply(newNodePr->comB),
+		                           0,
+		                           i - 3))
 			return false;
 
 		// Grow shape
-		for (int j = 0; j < i; j++)
-		{
-			auto & g = genes.at(j);
-			g.com() = g.com().dot(newNodePr->rot);
-			g.com() += newNodePr->tran;
-		}
+		frames.growForward(newNodePr);
+		genes.at(i).com() = frames.tipToWorld.origin();
+		grid.insert(i, genes.at(i));
+
+		if (tracker)
+			tracker->append(genes.at(i).com());
 	}
 
 	return true;
 }
 
-// Private methods
-
-Genes
-Chromosome::genRandomGenesReverse(
-    const uint genMaxLen,
-    Genes genes)
+void
+Chromosome::placeValid(Genes & genes)
 {
-	const size_t dim = myRelaMat->size();
-
 	if (genes.size() == 0)
-	{
-		// Pick random starting node
-		const uint firstNodeId = myGlobalRoulette.at(getDice(myGlobalRoulette.size()));
-		genes.emplace_back(firstNodeId, 0, 0, 0);
-	}
-	else
-	{
-		synthesiseReverse(genes);
-	}
-
-	// Reverse order so growth tip is at back
-	std::reverse(genes.begin(), genes.end());
+		return;
 
-	while (genes.size() <= genMaxLen)
+	// As GrowthFrames::growForward(), but nothing is moved
+	// into the tip frame afterwards
+	RigidTransform tipToWorld;
+	genes.at(0).com() = Point3f(0, 0, 0);
+	for (int i = 1; i < genes.size(); i++)
 	{
-		std::vector<uint> rouletteWheel;
-		const Gene & currGene = genes.back();
-
-		// Compute whether each neighbour is colliding
-		for (int i = 0; i < dim; i++)
-		{
-			const PairRelationship * prPtr = myRelaMat->at(i).at(currGene.nodeId());
-			if (prPtr == NULL)
-				continue;
+		const PairRelationship * pr = checkedPair(*myRelaMat, genes, i - 1, "placeValid");
+		tipToWorld = RigidTransform::inverse(pr->rotInv, pr->tran).then(tipToWorld);
+		genes.at(i).com() = tipToWorld.origin();
+	}
+}
 
-			const Point3f checkpoint = prPtr->tran;
+// Lent to whichever chromosome the thread is expanding
+static Genes &
+getExpansionScratch()
+{
+	static thread_local Genes scratch;
+	return scratch;
+}
 
-			// Create roulette based on number of LHS neighbours
-			// of the current neighbour being considered
-			if (!collides(i,
-			              checkpoint,
-			              genes.begin(),
-			              genes.end() - 2,
-			              *myRadiiList))
-			{
-				for (int j = 0; j < myNeighbourCounts.at(i).x; j++)
-					rouletteWheel.push_back(i);
-			}
-		}
+Chromosome::Expansion::Expansion(Chromosome & chromo, const bool fill)
+{
+	if (!chromo.idsOnly())
+		return;
 
-		if (rouletteWheel.size() == 0)
-			break;
+	myChromo = &chromo;
+	chromo.myGenes.swap(getExpansionScratch());
+	chromo.myGenes.clear();
 
-		// Pick a random valid neighbour
-		const uint nextNodeId = rouletteWheel.at(getDice(rouletteWheel.size()));
+	if (fill)
+	{
+		for (const CompactId id : chromo.myNodeIds)
+			chromo.myGenes.emplace_back(id);
+	}
 
-		const PairRelationship * nextNodePR = myRelaMat->at(nextNodeId).at(currGene.nodeId());
+	chromo.myExpanded = true;
+}
 
-		// Grow shape
-		for (auto & g : genes)
-		{
-			g.com() -= nextNodePR->tran;
-			g.com() = g.com().dot(nextNodePR->rotInv);
-		}
+Chromosome::Expansion::~Expansion()
+{
+	if (myChromo == NULL)
+		return;
 
-		genes.emplace_back(nextNodeId, 0, 0, 0);
-	}
+	myChromo->myExpanded = false;
+	myChromo->storeGenes(myChromo->myGenes);
 
-	// Reverse the reverse!
-	std::reverse(genes.begin(), genes.end());
+	// Hand the scratch back, keeping its capacity
+	myChromo->myGenes.clear();
+	myChromo->myGenes.swap(getExpansionScratch());
+}
 
-	return genes;
+bool
+Chromosome::synthesiseReverse(Genes & genes)
+{
+	return placeGenesReverse(genes, true);
 }
 
 /*
- * Generate a sequence of non-colliding nodes, with an
+ * Places genes in the frame of the first gene, growing from
+ * the last one, like synthesiseReverse(); collisions are only
+ * tested if check is set
+ */
+bool
+Chromosome::placeGenesReverse(Genes & genes, const bool check)
+{
+	const int N = genes.size();
+	if (N == 0)
+		return true;
+
+	GrowthFrames frames;
+	CollisionGrid & grid = getCollisionGrid();
+	grid.reset();
+
+	genes.at(N - 1).com() = Point3f(0, 0, 0);
+	if (check)
+		grid.insert(N - 1, genes.at(N - 1));
+
+	for (int i = N - 1; i > 0; i--)
+	{
+		const PairRelationship * newNodePr =
+		    checkedPair(*myRelaMat, genes, i - 1, "synthesiseReverse");
+
+		if (check)
+		{
+			// Check collision; the gene three on is looked up
+			if (i + 2 < N && ExclusionTable::excluded(genes.at(i - 1).nodeId(),
+			                                          genes.at(i).nodeId(),
+			                                          genes.at(i + 1).nodeId(),
+			                                          genes.at(i + 2).nodeId()))
+				return false;
+
+			if (grid.collides(genes.at(i - 1).nodeId(),
+			                  frames.tipToWorld.apply(newNodePr->tran),
+			                  i + 3,
+			                  N))
+				return false;
+		}
+
+		// Grow shape
+		frames.growReverse(newNodePr);
+		genes.at(i - 1).com() = frames.tipToWorld.origin();
+		if (check)
+			grid.insert(i - 1, genes.at(i - 1));
+	}
+
+	frames.toTipFrame(genes);
+
+	return true;
+}
+
+bool
+Chromosome::synthesise(Genes & genes, KabschTracker * tracker)
+{
+	if (genes.size() == 0)
+		return true;
+
+	GrowthFrames frames;
+	if (!placeGenes(genes, frames, tracker))
+		return false;
+
+	frames.toTipFrame(genes);
+
+	return true;
+}
+
+/*
+ * Each side of the junction is a piece of a valid chain, so
+ * pairs within a side were tested when that chain was made.
+ * The whole chain is placed without testing, then the sides
+ * are tested against each other through SegmentSpheres; pairs
+ * three apart across the junction are looked up first.
+ */
+bool
+Chromosome::synthesiseSplice(Genes & genes,
+                             const uint junction,
+                             KabschTracker * tracker)
+{
+	const int N = genes.size();
+	if (N == 0)
+		return true;
+
+	const int J = junction;
+	for (int w = std::max(J - 3, 0); w < J && w + 3 < N; w++)
+		if (ExclusionTable::excluded(genes.at(w).nodeId(),
+		                             genes.at(w + 1).nodeId(),
+		                             genes.at(w + 2).nodeId(),
+		                             genes.at(w + 3).nodeId()))
+			return false;
+
+	GrowthFrames frames;
+	genes.at(0).com() = Point3f(0, 0, 0);
+	for (int i = 1; i < N; i++)
+	{
+		frames.growForward(checkedPair(*myRelaMat, genes, i - 1, "synthesiseSplice"));
+		genes.at(i).com() = frames.tipToWorld.origin();
+	}
+
+	static thread_local SegmentSpheres lhs, rhs;
+	const std::vector<float> & radii = CollisionGrid::nodeRadii();
+	lhs.build(genes, radii, 0, J);
+	rhs.build(genes, radii, J, N);
+	if (lhs.collidesWith(rhs, genes, radii, 4))
+		return false;
+
+	if (tracker)
+	{
+		tracker->reset();
+		for (const auto & g : genes)
+			tracker->append(g.com());
+	}
+
+	frames.toTipFrame(genes);
+
+	return true;
+}
+
+// Private methods
+
+Genes
+Chromosome::genRandomGenesReverse(
+    const uint genMaxLen,
+    Genes genes)
+{
+	genes.reserve(genMaxLen);
+
+	if (genes.size() == 0)
+	{
+		// Pick random starting node
+		const uint firstNodeId = myGlobalRoulette.pick(getDice(myGlobalRoulette.total()));
+		genes.emplace_back(firstNodeId, 0, 0, 0);
+	}
+	else
+	{
+		// Starting genes are a suffix of a valid chain
+		placeGenesReverse(genes, false);
+	}
+
+	// Reverse order so growth tip is at back
+	std::reverse(genes.begin(), genes.end());
+
+	// The tip's frame is the world frame from here on
+	GrowthFrames frames;
+	CollisionGrid & grid = getCollisionGrid();
+	grid.build(genes);
+
+	static thread_local Roulette roulette;
+	while (genes.size() < genMaxLen)
+	{
+		roulette.clear();
+		const Gene & currGene = genes.back();
+
+		// Create roulette based on number of LHS neighbours
+		// of each non-colliding neighbour, leaving out those
+		// that cannot lead to a chain of minimum length
+		const uint minReach = myMinLen > genes.size() + 1 ? myMinLen - genes.size() - 1 : 0;
+		const WeightedNeighbours & neighbours = myLhsNeighbours.at(currGene.nodeId());
+		const int n = genes.size();
+		for (int i = 0; i < neighbours.size(); i++)
+		{
+			const WeightedNeighbour & nb = neighbours.at(i);
+			if (myLhsReach.at(nb.nodeId) < minReach)
+				continue;
+
+			// Genes run backwards here
+			if (n >= 3 && ExclusionTable::excluded(nb.nodeId,
+			                                       currGene.nodeId(),
+			                                       genes.at(n - 2).nodeId(),
+			                                       genes.at(n - 3).nodeId()))
+				continue;
+
+			if (!grid.collides(nb.nodeId,
+			                   frames.tipToWorld.apply(nb.pr->tran),
+			                   0,
+			                   n - 3))
+				roulette.add(i, nb.weight);
+		}
+
+		if (roulette.empty())
+			break;
+
+		// Pick a random valid neighbour
+		const WeightedNeighbour & next = neighbours.at(roulette.pick(getDice(roulette.total())));
+
+		// Grow shape
+		frames.growReverse(next.pr);
+		genes.emplace_back(next.nodeId, frames.tipToWorld.origin());
+		grid.insert(genes.size() - 1, genes.back());
+	}
+
+	frames.toTipFrame(genes);
+
+	// Reverse the reverse!
+	std::reverse(genes.begin(), genes.end());
+
+	return genes;
+}
+
+/*
+ * Generate a sequence of non-colliding nodes, with an
  * optional starting genes object and a maximum allowed
  * length. Minimum length should be checked outside this
  * function as the randomness might fail to produce
@@ -759,10 +1292,9 @@ Chromosome::genRandomGenesReverse(
 Genes
 Chromosome::genRandomGenes(
     const uint genMaxLen,
-    Genes genes)
+    Genes genes,
+    KabschTracker * tracker)
 {
-	const size_t dim = myRelaMat->size();
-
 	// A roulette wheel represents the probability of
 	// each node being picked as the next node, based
 	// on the number of neighbours they have.
@@ -775,72 +1307,393 @@ Chromosome::genRandomGenes(
 	// are simply repeated and we don't want this to
 	// happen often.
 
+	GrowthFrames frames;
+	CollisionGrid & grid = getCollisionGrid();
+	genes.reserve(genMaxLen);
+
 	if (genes.size() == 0)
 	{
 		// Pick random starting node
-		const uint firstNodeId = myGlobalRoulette.at(getDice(myGlobalRoulette.size()));
+		const uint firstNodeId = myGlobalRoulette.pick(getDice(myGlobalRoulette.total()));
 		genes.emplace_back(firstNodeId, 0, 0, 0);
+
+		grid.reset();
+		grid.insert(0, genes.back());
+
+		if (tracker)
+		{
+			tracker->reset();
+			tracker->append(genes.back().com());
+		}
 	}
 	else
 	{
-		synthesise(genes);
+		// Starting genes are a prefix of a valid chain, so
+		// they cannot collide
+		placeGenes(genes, frames, tracker, false);
 	}
 
-	while (genes.size() <= genMaxLen)
+	static thread_local Roulette roulette;
+	while (genes.size() < genMaxLen)
 	{
-		std::vector<uint> rouletteWheel;
+		roulette.clear();
 		const Gene & currGene = genes.back();
 
-		// Compute whether each neighbour is colliding
-		const std::vector<PairRelationship *> rr = myRelaMat->at(currGene.nodeId());
-		for (int i = 0; i < dim; i++)
+		// Create roulette based on number of RHS neighbours
+		// of each non-colliding neighbour, leaving out those
+		// that cannot lead to a chain of minimum length
+		const uint minReach = myMinLen > genes.size() + 1 ? myMinLen - genes.size() - 1 : 0;
+		const WeightedNeighbours & neighbours = myRhsNeighbours.at(currGene.nodeId());
+		const int n = genes.size();
+
+		// Neighbours that hit the gene three back, by the
+		// same index as neighbours
+		const char * excluded = n >= 3 ?
+		                        ExclusionTable::rhsRow(genes.at(n - 3).nodeId(),
+		                                               genes.at(n - 2).nodeId(),
+		                                               currGene.nodeId()) :
+		                        NULL;
+
+		for (int i = 0; i < neighbours.size(); i++)
 		{
-			const PairRelationship * prPtr = rr.at(i);
+			const WeightedNeighbour & nb = neighbours.at(i);
+			if (myRhsReach.at(nb.nodeId) < minReach ||
+			        (excluded && excluded[i]))
+				continue;
 
-			// Create roulette based on number of RHS neighbours
-			// of the current neighbour being considered
-			if (prPtr && !collides(i,
-			                       prPtr->comB,
-			                       genes.begin(),
-			                       genes.end() - 2,
-			                       *myRadiiList))
-			{
-				for (int j = 0; j < myNeighbourCounts.at(i).y; j++)
-					rouletteWheel.push_back(i);
-			}
+			if (!grid.collides(nb.nodeId,
+			                   frames.tipToWorld.apply(nb.pr->comB),
+			                   0,
+			                   n - 3))
+				roulette.add(i, nb.weight);
 		}
 
-		if (rouletteWheel.size() == 0)
+		if (roulette.empty())
 			break;
 
 		// Pick a random valid neighbour
-		const uint nextNodeId = rouletteWheel.at(getDice(rouletteWheel.size()));
-
-		const PairRelationship * nextNodePR = rr.at(nextNodeId);
+		const WeightedNeighbour & next = neighbours.at(roulette.pick(getDice(roulette.total())));
 
 		// Grow shape
-		for (auto & g : genes)
+		frames.growForward(next.pr);
+		genes.emplace_back(next.nodeId, frames.tipToWorld.origin());
+		grid.insert(genes.size() - 1, genes.back());
+
+		if (tracker)
+			tracker->append(genes.back().com());
+	}
+
+	frames.toTipFrame(genes);
+
+	return genes;
+}
+
+
+/*
+ * PointMutateScan
+ */
+
+void
+PointMutateScan::reset(const Genes & genes)
+{
+	const uint N = genes.size();
+	myGenes = &genes;
+	myCOMs.resize(N);
+	myTipToWorld.resize(N);
+	myWorldToTip.resize(N);
+	myGrid.reset();
+	myClean = true;
+
+	// Like Chromosome::placeGenes(), but the whole chain is
+	// placed even if it collides
+	Chromosome::GrowthFrames frames;
+	for (int i = 0; i < N; i++)
+	{
+		if (i > 0)
 		{
-			g.com() = g.com().dot(nextNodePR->rot);
-			g.com() += nextNodePR->tran;
+			const PairRelationship * pr =
+			    checkedPair(*Chromosome::myRelaMat, genes, i - 1, "PointMutateScan::reset");
+
+			if (myClean && i >= 3 &&
+			        ExclusionTable::excluded(genes.at(i - 3).nodeId(),
+			                                 genes.at(i - 2).nodeId(),
+			                                 genes.at(i - 1).nodeId(),
+			                                 genes.at(i).nodeId()))
+				myClean = false;
+
+			if (myClean &&
+			        myGrid.collides(genes.at(i).nodeId(),
+			                        frames.tipToWorld.apply(pr->comB),
+			                        0,
+			                        i - 3))
+				myClean = false;
+
+			frames.growForward(pr);
 		}
 
-		genes.emplace_back(nextNodeId, 0, 0, 0);
+		myCOMs.at(i) = frames.tipToWorld.origin();
+		myTipToWorld.at(i) = frames.tipToWorld;
+		myWorldToTip.at(i) = frames.worldToTip;
+		myGrid.insert(i, Gene(genes.at(i).nodeId(), myCOMs.at(i)));
 	}
+}
 
-	return genes;
+bool
+PointMutateScan::canSwap(const uint i, const uint nodeId)
+{
+	return feasible(i, nodeId, i + 1);
+}
+
+bool
+PointMutateScan::canInsert(const uint i, const uint nodeId)
+{
+	return feasible(i, nodeId, i);
+}
+
+bool
+PointMutateScan::canDelete(const uint i)
+{
+	return feasible(i, -1, i + 1);
+}
+
+// Private methods
+
+/*
+ * The prefix keeps its placement and the suffix keeps its
+ * shape, so pairs within either were already tested by
+ * reset(). Candidate gene c is tested against genes before
+ * c - 2 (see placeGenes()); here that leaves suffix genes
+ * against the prefix, and the new gene against both sides.
+ * Pairs three apart across the change are looked up in the
+ * ExclusionTable first, so most infeasible candidates never
+ * get placed.
+ */
+bool
+PointMutateScan::feasible(
+    const uint prefixLen,
+    const int newId,
+    const uint suffixBegin)
+{
+	const Genes & genes = *myGenes;
+	const int N = genes.size();
+	const int p = prefixLen;
+	const int s = suffixBegin;
+
+	if (!myClean)
+	{
+		myScratch.assign(genes.begin(), genes.begin() + p);
+		if (newId >= 0)
+			myScratch.emplace_back(newId);
+		myScratch.insert(myScratch.end(), genes.begin() + s, genes.end());
+		return Chromosome::synthesise(myScratch);
+	}
+
+	// Candidate chain is genes [0, p), newId, genes [s, N)
+	const int hasNew = newId >= 0;
+	const int M = p + hasNew + N - s;
+	auto idAt = [&](const int c) {
+		if (c < p)
+			return genes.at(c).nodeId();
+		if (hasNew && c == p)
+			return (uint) newId;
+		return genes.at(c - p - hasNew + s).nodeId();
+	};
+
+	for (int w = std::max(p - 3, 0); w <= p + hasNew - 1 && w + 3 < M; w++)
+		if (ExclusionTable::excluded(idAt(w), idAt(w + 1), idAt(w + 2), idAt(w + 3)))
+			return false;
+
+	const RelaMat & relaMat = *Chromosome::myRelaMat;
+	auto pairOf = [&relaMat](const uint lhsId, const uint rhsId) {
+		const PairRelationship * pr = relaMat.at(lhsId).at(rhsId);
+		panic_if(pr == NULL,
+		         "PointMutateScan: impossible pair %u <-x-> %u\n", lhsId, rhsId);
+		return pr;
+	};
+
+	// Frames of the last candidate gene placed so far; the
+	// first gene of an empty prefix is placed at the origin
+	Chromosome::GrowthFrames frames;
+	int prevId = -1;
+	if (p > 0)
+	{
+		frames.tipToWorld = myTipToWorld.at(p - 1);
+		frames.worldToTip = myWorldToTip.at(p - 1);
+		prevId = genes.at(p - 1).nodeId();
+	}
+
+	Point3f newCOM;
+	if (newId >= 0)
+	{
+		if (prevId >= 0)
+		{
+			const PairRelationship * pr = pairOf(prevId, newId);
+			if (myGrid.collides(newId, frames.tipToWorld.apply(pr->comB), 0, p - 3))
+				return false;
+
+			frames.growForward(pr);
+		}
+
+		newCOM = frames.tipToWorld.origin();
+		prevId = newId;
+	}
+
+	if (s >= N)
+		return true;
+
+	if (prevId >= 0)
+		frames.growForward(pairOf(prevId, genes.at(s).nodeId()));
+
+	// Suffix genes are moved from their reset() placement
+	const RigidTransform toCandidate =
+	    myWorldToTip.at(s).then(frames.tipToWorld);
+	const int suffixCandidateBegin = p + hasNew;
+
+	if (p > 0)
+	{
+		for (int k = s; k < N; k++)
+		{
+			const int c = suffixCandidateBegin + k - s;
+			if (myGrid.collides(genes.at(k).nodeId(),
+			                    toCandidate.apply(myCOMs.at(k)),
+			                    0,
+			                    std::min(p, c - 3)))
+				return false;
+		}
+	}
+
+	// The new gene is moved into the reset() frame instead,
+	// where the suffix is already in the grid
+	if (newId >= 0)
+	{
+		const RigidTransform toOriginal =
+		    frames.worldToTip.then(myTipToWorld.at(s));
+		if (myGrid.collides(newId, toOriginal.apply(newCOM), s + 3, N))
+			return false;
+	}
+
+	return true;
+}
+
+PointMutateScan &
+getPointMutateScan()
+{
+	static thread_local PointMutateScan scan;
+	return scan;
+}
+
+/*
+ * Verdict on every point mutation of genes whose pairs
+ * exist, in pointMutate() order, either from the scan or
+ * from synthesising a mutated copy per candidate
+ */
+static void
+pointMutateVerdicts(
+    const Genes & genes,
+    const RelaMat & relaMat,
+    const bool useScan,
+    std::vector<bool> & verdicts)
+{
+	const int N = genes.size();
+	const int dim = relaMat.size();
+	auto linked = [&relaMat](const uint lhsId, const uint rhsId) {
+		return relaMat.at(lhsId).at(rhsId) != NULL;
+	};
+
+	PointMutateScan & scan = getPointMutateScan();
+	if (useScan)
+		scan.reset(genes);
+
+	verdicts.clear();
+	for (int i = 0; i < N; i++)
+	{
+		for (int j = 0; j < dim; j++)
+		{
+			if (j != genes.at(i).nodeId() &&
+			        (i == 0 || linked(genes.at(i - 1).nodeId(), j)) &&
+			        (i == N - 1 || linked(j, genes.at(i + 1).nodeId())))
+			{
+				if (useScan)
+				{
+					verdicts.push_back(scan.canSwap(i, j));
+				}
+				else
+				{
+					Genes testGenes(genes);
+					testGenes.at(i).nodeId() = j;
+					verdicts.push_back(Chromosome::synthesise(testGenes));
+				}
+			}
+
+			if ((i == 0 || linked(genes.at(i - 1).nodeId(), j)) &&
+			        linked(j, genes.at(i).nodeId()))
+			{
+				if (useScan)
+				{
+					verdicts.push_back(scan.canInsert(i, j));
+				}
+				else
+				{
+					Genes testGenes(genes);
+					testGenes.insert(testGenes.begin() + i, Gene(j));
+					verdicts.push_back(Chromosome::synthesise(testGenes));
+				}
+			}
+		}
+
+		if (i == 0 || i == N - 1 ||
+		        linked(genes.at(i - 1).nodeId(), genes.at(i + 1).nodeId()))
+		{
+			if (useScan)
+			{
+				verdicts.push_back(scan.canDelete(i));
+			}
+			else
+			{
+				Genes testGenes(genes);
+				testGenes.erase(testGenes.begin() + i);
+				verdicts.push_back(Chromosome::synthesise(testGenes));
+			}
+		}
+	}
 }
 
+/*
+ * Every child cross() could make of mother and father, as
+ * mother [0, i) then father [j, end) with mother i and father
+ * j the same node, no longer than Chromosome::maxLen()
+ */
+static void
+spliceChains(
+    const Genes & mother,
+    const Genes & father,
+    std::vector<std::tuple<Genes, uint>> & splices)
+{
+	for (int i = 1; i < mother.size(); i++)
+	{
+		for (int j = 0; j < father.size(); j++)
+		{
+			if (mother.at(i).nodeId() != father.at(j).nodeId() ||
+			        i + father.size() - j > Chromosome::maxLen())
+				continue;
+
+			Genes child(mother.begin(), mother.begin() + i);
+			child.insert(child.end(), father.begin() + j, father.end());
+			splices.emplace_back(child, i);
+		}
+	}
+}
 
 int _testChromosome()
 {
 	using namespace elfin;
 
-	// Load necessary data to setup Gene
-	RelaMat relaMat;
-	NameIdMap nameIdMap;
-	IdNameMap idNameMap;
-	RadiiList radiiList;
+	// Load necessary data to setup Gene; Gene and Chromosome
+	// keep pointing into it for the tests that follow
+	static RelaMat relaMat;
+	static NameIdMap nameIdMap;
+	static IdNameMap idNameMap;
+	static RadiiList radiiList;
 	JSONParser().parseDB("../../res/xDB.json", nameIdMap, idNameMap, relaMat, radiiList);
 
 	Gene::setup(&idNameMap);
@@ -937,6 +1790,210 @@ int _testChromosome()
 		msg("Self score: %f\n", selfScore);
 	}
 
+	// Test incremental Kabsch tracking through synthesis
+	// against a jittered copy of the known solution
+	{
+		uint seed = 0x1337;
+		const Points3f jittered = jitterPoints(l10Solution1, 5.0f, seed);
+		const SpecScoringContext ctx(jittered, 0, 100);
+		KabschTracker tracker(&ctx);
+
+		// Copy through const access to keep chromo's score valid
+		const Chromosome & scoredChromo = chromo;
+		Genes trackedGenes = scoredChromo.genes();
+		Chromosome::synthesise(trackedGenes, &tracker);
+
+		const float expected = kabschScore(trackedGenes, ctx);
+		const float tracked = tracker.score(ScoreBackend::Rosetta);
+		msg("Tracked score: %f, full score: %f\n", tracked, expected);
+		if (!tracker.complete() ||
+		        !float_approximates_err(tracked, expected, 1e-3 * (1 + expected)))
+		{
+			failCount++;
+			err("Incremental Kabsch score differs from full score\n");
+		}
+
+		// Partial chain against spec prefix
+		const uint prefixLen = 6;
+		Genes prefix(trackedGenes.begin(), trackedGenes.begin() + prefixLen);
+		Chromosome::synthesise(prefix, &tracker);
+		const Points3f specPrefix(jittered.begin(), jittered.begin() + prefixLen);
+
+		Points3f prefixPts;
+		for (const auto & g : prefix)
+			prefixPts.push_back(g.com());
+
+		const float expectedPrefix = kabschScore(prefixPts, specPrefix);
+		const float trackedPrefix = tracker.score(ScoreBackend::QCP);
+		if (tracker.size() != prefixLen ||
+		        !float_approximates_err(trackedPrefix, expectedPrefix, 1e-3 * (1 + expectedPrefix)))
+		{
+			failCount++;
+			err("Incremental prefix score differs: %f vs %f\n",
+			    trackedPrefix, expectedPrefix);
+		}
+	}
+
+	// Test splice synthesis against synthesising the whole
+	// crossed chain
+	{
+		uint mismatches = 0, feasible = 0, candidates = 0;
+		std::vector<std::tuple<Genes, uint>> splices;
+		for (int c = 0; c < 40; c++)
+		{
+			const Genes mother = Chromosome::genRandomGenes(10 + c % 3 * 10);
+			const Genes father = Chromosome::genRandomGenes(10 + c % 4 * 10);
+
+			splices.clear();
+			spliceChains(mother, father, splices);
+			for (auto & s : splices)
+			{
+				Genes whole = std::get<0>(s);
+				Genes spliced = std::get<0>(s);
+				const bool wholeOk = Chromosome::synthesise(whole);
+				const bool splicedOk = Chromosome::synthesiseSplice(spliced, std::get<1>(s));
+
+				bool same = wholeOk == splicedOk;
+				for (int i = 0; same && wholeOk && i < whole.size(); i++)
+					same = whole.at(i).com().approximates(spliced.at(i).com());
+
+				mismatches += !same;
+				feasible += wholeOk;
+				candidates++;
+			}
+		}
+
+		if (mismatches > 0 || feasible == 0 || feasible == candidates)
+		{
+			failCount++;
+			err("synthesiseSplice() disagrees with synthesise() on %u of %u splices (%u feasible)\n",
+			    mismatches, candidates, feasible);
+		}
+	}
+
+	// Test point mutation scan against synthesising every
+	// mutated chain
+	{
+		uint mismatches = 0, feasible = 0, candidates = 0;
+		std::vector<bool> scanned, synthesised;
+		for (int c = 0; c < 40; c++)
+		{
+			const Genes chain = Chromosome::genRandomGenes(10 + c % 3 * 10);
+
+			pointMutateVerdicts(chain, relaMat, true, scanned);
+			pointMutateVerdicts(chain, relaMat, false, synthesised);
+
+			for (int v = 0; v < scanned.size(); v++)
+			{
+				mismatches += scanned.at(v) != synthesised.at(v);
+				feasible += synthesised.at(v);
+			}
+			candidates += scanned.size();
+		}
+
+		if (mismatches > 0 || feasible == 0 || feasible == candidates)
+		{
+			failCount++;
+			err("PointMutateScan disagrees with synthesise() on %u of %u candidates (%u feasible)\n",
+			    mismatches, candidates, feasible);
+		}
+	}
+
+	// Test compact chromosomes: the same chains as placed ones,
+	// through assignments and operators
+	{
+		uint mismatches = 0, invalid = 0, expanded = 0;
+		auto validChain = [](const Chromosome & c) {
+			Genes genes = c.genes();
+			return Chromosome::synthesise(genes);
+		};
+
+		Chromosome mother, father, child, placed;
+		mother.setCompact(true);
+		father.setCompact(true);
+		child.setCompact(true);
+		for (int c = 0; c < 40; c++)
+		{
+			Chromosome source;
+			source.randomise();
+			mother = source;
+			father.randomise();
+
+			// Only chain shapes count: compact genes are placed
+			// in the frame of the first gene
+			const Genes & sourceGenes = source.genes();
+			const Genes & motherGenes = static_cast<const Chromosome &>(mother).genes();
+			for (int i = 1; i < sourceGenes.size(); i++)
+			{
+				const float d = sourceGenes.at(0).com().distTo(sourceGenes.at(i).com());
+				if (!float_approximates_err(d, motherGenes.at(0).com().distTo(motherGenes.at(i).com()), 1e-3))
+				{
+					mismatches++;
+					break;
+				}
+			}
+
+			if (mother.checksum() != source.checksum() ||
+			        mother.getNodeNames() != source.getNodeNames() ||
+			        mother.length() != source.length())
+				mismatches++;
+
+			if (c % 4 == 0)
+				mother.cross(father, child) || (mother.mutateChild(child), true);
+			else if (c % 4 == 1)
+				mother.copy(child), child.pointMutate();
+			else if (c % 4 == 2)
+				mother.copy(child), child.limbMutate();
+			else
+				mother.mutateChild(child);
+
+			invalid += !validChain(child) || !validChain(mother) || !validChain(father);
+			expanded += !child.compact() || !mother.compact();
+
+			placed = child;
+			expanded += placed.compact();
+			mismatches += placed.checksum() != child.checksum();
+		}
+
+		if (mismatches > 0 || invalid > 0 || expanded > 0)
+		{
+			failCount++;
+			err("Compact chromosomes: %u mismatches, %u invalid chains, %u changed representation\n",
+			    mismatches, invalid, expanded);
+		}
+	}
+
+	// Test score validity flag
+	Chromosome scoredCopy;
+	chromo.copy(scoredCopy);
+	if (!chromo.scoreValid() || !scoredCopy.scoreValid())
+	{
+		failCount++;
+		err("Scored chromosome or its copy lost score validity\n");
+	}
+
+	scoredCopy.randomise();
+	if (scoredCopy.scoreValid())
+	{
+		failCount++;
+		err("randomise() did not invalidate score\n");
+	}
+
+	scoredCopy.setScoreBound(123.0f);
+	if (scoredCopy.scoreValid() || !scoredCopy.scoreIsBound() ||
+	        scoredCopy.getScore() != 123.0f)
+	{
+		failCount++;
+		err("setScoreBound() must leave score invalid but bounded\n");
+	}
+
+	scoredCopy.setScore(100.0f);
+	if (!scoredCopy.scoreValid() || scoredCopy.scoreIsBound())
+	{
+		failCount++;
+		err("setScore() did not replace score bound\n");
+	}
+
 	// Test verdict
 	if (failCount == 0)
 		msg("Passed!\n");
@@ -946,4 +2003,231 @@ int _testChromosome()
 	return 0;
 }
 
+int _benchPointMutate()
+{
+	msg("Benchmarking point mutation scans: synthesise() per candidate vs PointMutateScan\n");
+
+	const uint lens[] = { 10, 20, 30 };
+	const uint chainsPerLen = 100;
+
+	const BenchDB & db = setupBenchChromosome(100);
+
+	int failCount = 0;
+	for (const uint len : lens)
+	{
+		double synthTime = 0.0, scanTime = 0.0;
+		ulong candidates = 0, mismatches = 0;
+		std::vector<bool> synthesised, scanned;
+
+		for (int c = 0; c < chainsPerLen; c++)
+		{
+			Genes chain;
+			do
+			{
+				chain = Chromosome::genRandomGenes(len);
+			}
+			while (chain.size() < len);
+
+			double t0 = get_timestamp_us();
+			pointMutateVerdicts(chain, db.relaMat, false, synthesised);
+			synthTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			pointMutateVerdicts(chain, db.relaMat, true, scanned);
+			scanTime += get_timestamp_us() - t0;
+
+			candidates += scanned.size();
+			for (int v = 0; v < scanned.size(); v++)
+				mismatches += scanned.at(v) != synthesised.at(v);
+		}
+
+		if (mismatches > 0)
+		{
+			failCount++;
+			err("PointMutateScan disagrees with synthesise() on %lu candidates\n", mismatches);
+		}
+
+		msg("len %u (%.0f candidates/chain): synthesise %.1fus/chain, scan %.1fus/chain (%.2fx)\n",
+		    len,
+		    (float) candidates / chainsPerLen,
+		    synthTime / chainsPerLen,
+		    scanTime / chainsPerLen,
+		    synthTime / scanTime);
+	}
+
+	return failCount;
+}
+
+int _benchSynthesiseSplice()
+{
+	msg("Benchmarking crossed chain synthesis: synthesise() vs synthesiseSplice()\n");
+
+	const BenchDB & db = setupBenchChromosome(100);
+
+	// Chains the solver found for the l30 specs, and random
+	// chains of 100 genes
+	std::vector<Genes> l30Chains;
+	const std::string l30Dir = std::string(BENCH_SPEC_ROOT) + "l30";
+	for (const auto & spec : loadBenchSpecs(l30Dir))
+	{
+		const JSON json = JSONParser().parse(l30Dir + "/" + spec.name);
+		Genes chain;
+		for (const auto & name : json["nodes"])
+			chain.emplace_back(db.nameIdMap.at(name.get<std::string>()));
+		l30Chains.push_back(chain);
+	}
+
+	std::vector<Genes> longChains;
+	for (int c = 0; c < 40; c++)
+	{
+		Genes chain;
+		do
+		{
+			chain = Chromosome::genRandomGenes(100);
+		}
+		while (chain.size() < 100);
+		longChains.push_back(chain);
+	}
+
+	const std::vector<Genes> * sets[] = { &l30Chains, &longChains };
+	const char * setNames[] = { "l30", "len 100" };
+	const int reps = 5;
+
+	int failCount = 0;
+	for (int s = 0; s < 2; s++)
+	{
+		std::vector<std::tuple<Genes, uint>> splices;
+		const std::vector<Genes> & chains = *sets[s];
+		if (chains.size() <= 8)
+		{
+			for (const auto & mother : chains)
+				for (const auto & father : chains)
+					spliceChains(mother, father, splices);
+		}
+		else
+		{
+			// Every pair would not fit in memory
+			for (int c = 0; c < chains.size(); c++)
+				spliceChains(chains.at(c), chains.at((c + 1) % chains.size()), splices);
+		}
+
+		if (splices.empty())
+		{
+			failCount++;
+			err("No %s splices to benchmark\n", setNames[s]);
+			continue;
+		}
+
+		double wholeTime = 0.0, spliceTime = 0.0;
+		ulong mismatches = 0, feasible = 0, genes = 0;
+		for (const auto & sp : splices)
+		{
+			Genes work = std::get<0>(sp);
+			bool wholeOk = false, splicedOk = false;
+
+			double t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				wholeOk = Chromosome::synthesise(work);
+			wholeTime += get_timestamp_us() - t0;
+
+			t0 = get_timestamp_us();
+			for (int r = 0; r < reps; r++)
+				splicedOk = Chromosome::synthesiseSplice(work, std::get<1>(sp));
+			spliceTime += get_timestamp_us() - t0;
+
+			mismatches += wholeOk != splicedOk;
+			feasible += wholeOk;
+			genes += work.size();
+		}
+
+		if (mismatches > 0)
+		{
+			failCount++;
+			err("synthesiseSplice() disagrees with synthesise() on %lu %s splices\n",
+			    mismatches, setNames[s]);
+		}
+
+		const double count = (double) reps * splices.size();
+		msg("%s: %lu splices (avg %.1f genes, %.0f%% feasible): synthesise %.2fus, splice %.2fus (%.2fx)\n",
+		    setNames[s],
+		    splices.size(),
+		    (float) genes / splices.size(),
+		    100.0f * feasible / splices.size(),
+		    wholeTime / count,
+		    spliceTime / count,
+		    wholeTime / spliceTime);
+	}
+
+	return failCount;
+}
+
+int _benchGeneSlab()
+{
+	msg("Benchmarking offspring copies: temporaries vs chromosomes bound to a GeneSlab\n");
+
+	const ulong popSize = 16384;
+	const int reps = 5;
+
+	setupBenchChromosome(100);
+
+	std::vector<Chromosome> parents;
+	for (ulong i = 0; i < popSize; i++)
+		parents.emplace_back(Chromosome::genRandomGenes());
+
+	// As offspring used to be made: a copy returned by value,
+	// then assigned over the child
+	std::vector<Chromosome> loose(popSize);
+	GeneSlab slab;
+	slab.reset(popSize, Chromosome::maxLen());
+	std::vector<Chromosome> bound(popSize);
+	for (ulong i = 0; i < popSize; i++)
+		bound[i].genes().bind(slab.slot(i), Chromosome::maxLen());
+
+	int failCount = 0;
+	double looseTime = 0.0, boundTime = 0.0;
+	ulong looseAllocs = 0, boundAllocs = 0;
+	for (int r = 0; r < reps; r++)
+	{
+		// Different parents each time, as between generations
+		const ulong shift = r * 7919;
+
+		ulong allocs = getAllocCount();
+		double t0 = get_timestamp_us();
+		for (ulong i = 0; i < popSize; i++)
+		{
+			const Chromosome tmp(parents[(i + shift) % popSize]);
+			loose[i] = tmp;
+		}
+		looseTime += get_timestamp_us() - t0;
+		looseAllocs += getAllocCount() - allocs;
+
+		allocs = getAllocCount();
+		t0 = get_timestamp_us();
+		for (ulong i = 0; i < popSize; i++)
+			parents[(i + shift) % popSize].copy(bound[i]);
+		boundTime += get_timestamp_us() - t0;
+		boundAllocs += getAllocCount() - allocs;
+
+		for (ulong i = 0; i < popSize; i++)
+		{
+			if (bound[i].checksum() != loose[i].checksum() || !bound[i].genes().bound())
+			{
+				failCount++;
+				err("Bound copy %lu differs from its parent or left its slot\n", i);
+				break;
+			}
+		}
+	}
+
+	msg("%lu chromosomes: temporaries %.2fms (%.1f allocs each), slab %.2fms (%.1f allocs each) (%.2fx)\n",
+	    popSize,
+	    looseTime / reps / 1e3,
+	    (float) looseAllocs / reps / popSize,
+	    boundTime / reps / 1e3,
+	    (float) boundAllocs / reps / popSize,
+	    looseTime / boundTime);
+
+	return failCount;
+}
+
 } // namespace elfin
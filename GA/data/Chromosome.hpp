@@ -1,12 +1,16 @@
 #ifndef _CHROMOSOME_HPP_
 #define _CHROMOSOME_HPP_
 
+#include <atomic>
 #include <cmath>
 #include <string>
 
 #include "TypeDefs.hpp"
 #include "Gene.hpp"
 #include "../core/Checksum.hpp"
+#include "../core/KabschTracker.hpp"
+#include "../core/CollisionGrid.hpp"
+#include "../core/Roulette.hpp"
 
 namespace elfin
 {
@@ -27,6 +31,9 @@ namespace elfin
 
 GEN_ENUM_AND_STRING(Origin, OriginString, FOREACH_ORIGIN);
 
+// Node ID as kept by compact chromosomes
+typedef uchar CompactId;
+
 class Chromosome
 {
 public:
@@ -36,6 +43,10 @@ public:
 	Chromosome(const Genes & genes);
 	virtual ~Chromosome() {};
 
+	// Keeps this chromosome's representation, compact or not,
+	// whatever rhs uses
+	Chromosome & operator=(const Chromosome & rhs);
+
 	bool operator>(const Chromosome & rhs) const;
 	bool operator<(const Chromosome & rhs) const;
 
@@ -43,41 +54,137 @@ public:
 
 	// Getter & setters
 	float getScore() const;
-	Genes & genes();
+	void setScore(const float score);
+	bool scoreValid() const;
+	void invalidateScore();
+	// A bound stands in for the score but leaves it invalid
+	// so it is looked at again next generation
+	void setScoreBound(const float bound);
+	bool scoreIsBound() const;
+	Genes & genes(); // Invalidates score because genes may be modified
+	// For a compact chromosome, genes placed into scratch of
+	// the calling thread (in the frame of the first gene, not
+	// the last), good until its next call on another compact
+	// chromosome
 	const Genes & genes() const;
+	uint length() const;
 	Crc32 checksum() const;
 	std::vector<std::string> getNodeNames() const;
 
 	std::string toString() const;
 	bool cross(const Chromosome & father, Chromosome & out) const;
-	Chromosome mutateChild() const;
+	// A mutated copy of this chromosome, written into out
+	void mutateChild(Chromosome & out) const;
 	void autoMutate();
 	void randomise();
 	bool pointMutate();
 	bool limbMutate();
 	void setOrigin(Origin o);
 	Origin getOrigin() const;
-	Chromosome copy() const;
+	void copy(Chromosome & out) const;
+	// Exchanges contents without copying genes
+	void swap(Chromosome & rhs);
+
+	// Compact chromosomes keep only node IDs, one byte each,
+	// with room for maxLen() of them, and place their genes
+	// when scored or mutated
+	void setCompact(const bool compact);
+	bool compact() const;
 
 	static Genes genRandomGenesReverse(
 	    const uint genMaxLen = myMaxLen,
 	    Genes genes = Genes());
 	static Genes genRandomGenes(
 	    const uint genMaxLen = myMaxLen,
-	    Genes genes = Genes());
+	    Genes genes = Genes(),
+	    KabschTracker * tracker = NULL);
 
 	static void setup(const uint minLen,
 	                  const uint maxLen,
 	                  const RelaMat & relaMat,
-	                  const RadiiList & radiiList);
+	                  const RadiiList & radiiList,
+	                  const CollisionMeasure measure = MaxHeavy);
 	static uint calcExpectedLength(const Points3f & lenRef,
 	                               const float avgPairDist);
+	static void setupIncrementalScoring(const SpecScoringContext * ctx,
+	                                    const ScoreBackend backend);
 	static bool synthesiseReverse(Genes & genes);
-	static bool synthesise(Genes & genes);
+	static bool synthesise(Genes & genes, KabschTracker * tracker = NULL);
+	// synthesise() for genes whose [0, junction) and
+	// [junction, end) each come from a valid chain, as after
+	// cross(); only pairs across the junction are tested
+	static bool synthesiseSplice(Genes & genes,
+	                             const uint junction,
+	                             KabschTracker * tracker = NULL);
+
+	static uint minLen();
+	static uint maxLen();
+
+	// Grown chains thrown away so far for being too short or
+	// too long, over all threads
+	static ulong randomiseRejects();
+	static ulong limbRegrowRetries();
 
 private:
+	friend class PointMutateScan;
+	friend class ChainBatch;
+	struct GrowthFrames;
+
+	/*
+	 * Lets operators edit a compact chromosome through myGenes
+	 * as usual. For the guard's lifetime myGenes is the calling
+	 * thread's scratch chain holding the node IDs (unless fill
+	 * is false), unplaced: operators place whatever they
+	 * change anyway. Afterwards only the node IDs of whatever
+	 * genes are left are kept. Does nothing for chromosomes
+	 * that are not compact, or already expanded.
+	 */
+	class Expansion
+	{
+	public:
+		Expansion(Chromosome & chromo, const bool fill = true);
+		~Expansion();
+
+	private:
+		Chromosome * myChromo = NULL;
+	};
+
+	// A neighbour of a node, weighted by the neighbour's
+	// own neighbour count in the growth direction
+	struct WeightedNeighbour
+	{
+		uint nodeId;
+		uint weight;
+		const PairRelationship * pr;
+	};
+	typedef std::vector<WeightedNeighbour> WeightedNeighbours;
+
+	static std::vector<uint> calcReach(const std::vector<WeightedNeighbours> & neighbours,
+	                                   const uint cap);
+
+	void scoreFromTracker(const KabschTracker * tracker);
+	// Whether only myNodeIds holds the chain
+	bool idsOnly() const;
+	uint nodeIdAt(const uint i) const;
+	void assignFrom(const Chromosome & rhs);
+	// Into whichever representation this uses
+	void storeGenes(const Genes & genes);
+	// Places a chain known to be valid, first gene at the
+	// origin, without testing it
+	static void placeValid(Genes & genes);
+	static bool placeGenes(Genes & genes,
+	                       GrowthFrames & frames,
+	                       KabschTracker * tracker,
+	                       const bool check = true);
+	static bool placeGenesReverse(Genes & genes, const bool check);
+
 	Genes myGenes;
+	std::vector<CompactId> myNodeIds; // Compact chromosomes only
+	bool myCompact = false;
+	bool myExpanded = false; // Compact, but editing placed genes
 	float myScore = NAN;
+	bool myScoreValid = false; // Cleared by every operator that changes genes
+	bool myScoreIsBound = false;
 	Origin myOrigin = Origin::New;
 
 	static bool setupDone;
@@ -86,10 +193,76 @@ private:
 	static const RelaMat * myRelaMat;
 	static const RadiiList * myRadiiList;
 	static IdPairs myNeighbourCounts;
-	static IdRoulette myGlobalRoulette;
+	static Roulette myGlobalRoulette;
+	// By node ID, in ascending neighbour ID order
+	static std::vector<WeightedNeighbours> myRhsNeighbours; // For forward growth
+	static std::vector<WeightedNeighbours> myLhsNeighbours; // For reverse growth
+	// Most modules that can follow (rhs) or precede (lhs)
+	// each node, capped at myMinLen
+	static std::vector<uint> myRhsReach;
+	static std::vector<uint> myLhsReach;
+
+	static std::atomic<ulong> myRandomiseRejects;
+	static std::atomic<ulong> myLimbRegrowRetries;
+
+	// Set when chromosomes score themselves while growing
+	static const SpecScoringContext * myIncrementalCtx;
+	static ScoreBackend myIncrementalBackend;
 };
 
+/*
+ * Feasibility of the point mutations of one chain, without
+ * synthesising a copy of it per candidate. reset() places
+ * the chain once and keeps every gene's position and frame.
+ *
+ * A candidate keeps the genes before the change where they
+ * are, and moves the genes after it rigidly, so only pairs
+ * between the two sides and pairs involving an inserted or
+ * swapped-in gene need testing. Verdicts match synthesise()
+ * on the mutated genes up to rounding.
+ */
+class PointMutateScan
+{
+public:
+	// Genes must stay alive and unchanged until the next
+	// reset()
+	void reset(const Genes & genes);
+
+	// Gene i becomes nodeId
+	bool canSwap(const uint i, const uint nodeId);
+
+	// nodeId is inserted before gene i
+	bool canInsert(const uint i, const uint nodeId);
+
+	// Gene i is removed
+	bool canDelete(const uint i);
+
+private:
+	// Genes [0, prefixLen), then newId unless it is -1, then
+	// genes [suffixBegin, size)
+	bool feasible(const uint prefixLen,
+	              const int newId,
+	              const uint suffixBegin);
+
+	const Genes * myGenes = NULL;
+	Points3f myCOMs; // World frame
+	std::vector<RigidTransform> myTipToWorld;
+	std::vector<RigidTransform> myWorldToTip;
+	CollisionGrid myGrid;
+
+	// Chains that collide with themselves are checked by
+	// synthesising the mutated genes instead
+	bool myClean = false;
+	Genes myScratch;
+};
+
+// Per-thread scan for Chromosome::pointMutate()
+PointMutateScan & getPointMutateScan();
+
 int _testChromosome();
+int _benchPointMutate();
+int _benchSynthesiseSplice();
+int _benchGeneSlab();
 } // namespace elfin
 
 #endif /* include guard */
@@ -1,4 +1,8 @@
 #include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <type_traits>
 
 #include "Gene.hpp"
 
@@ -80,6 +84,228 @@ Gene::setup(const IdNameMap * _inm)
 	setupDone = true;
 }
 
+// Genes
+
+static_assert(std::is_trivially_copyable<Gene>::value,
+              "Genes copies genes as plain memory");
+
+Genes::Genes(const Genes & rhs)
+{
+	*this = rhs;
+}
+
+Genes::Genes(Genes && rhs)
+{
+	*this = std::move(rhs);
+}
+
+Genes::Genes(const_iterator first, const_iterator last)
+{
+	insert(end(), first, last);
+}
+
+Genes::~Genes()
+{
+	if (myOwned)
+		::operator delete(myData);
+}
+
+Genes &
+Genes::operator=(const Genes & rhs)
+{
+	if (this != &rhs)
+	{
+		mySize = 0;
+		grow(rhs.mySize);
+		std::uninitialized_copy(rhs.begin(), rhs.end(), myData);
+		mySize = rhs.mySize;
+	}
+
+	return *this;
+}
+
+Genes &
+Genes::operator=(Genes && rhs)
+{
+	if (this == &rhs)
+		return *this;
+
+	// Slots are not handed over
+	if (bound() || !rhs.myOwned)
+		return *this = rhs;
+
+	if (myOwned)
+		::operator delete(myData);
+
+	myData = rhs.myData;
+	mySize = rhs.mySize;
+	myCapacity = rhs.myCapacity;
+	myOwned = true;
+
+	rhs.myData = NULL;
+	rhs.mySize = rhs.myCapacity = 0;
+	rhs.myOwned = false;
+
+	return *this;
+}
+
+void
+Genes::bind(Gene * slot, const uint slotLen)
+{
+	panic_if(mySize > slotLen,
+	         "Genes::bind(): %u genes do not fit a slot of %u\n",
+	         mySize, slotLen);
+
+	std::uninitialized_copy(begin(), end(), slot);
+	if (myOwned)
+		::operator delete(myData);
+
+	myData = slot;
+	myCapacity = slotLen;
+	myOwned = false;
+}
+
+void
+Genes::reserve(const uint n)
+{
+	grow(n);
+}
+
+void
+Genes::assign(const_iterator first, const_iterator last)
+{
+	if (first >= myData && first < myData + mySize)
+	{
+		erase(last, end());
+		erase(begin(), first);
+		return;
+	}
+
+	clear();
+	insert(end(), first, last);
+}
+
+void
+Genes::push_back(const Gene & gene)
+{
+	// gene may be one of ours, and move if we grow
+	const Gene copy = gene;
+	emplace_back(copy);
+}
+
+Genes::iterator
+Genes::insert(const_iterator pos, const Gene & gene)
+{
+	return insert(pos, &gene, &gene + 1);
+}
+
+Genes::iterator
+Genes::insert(const_iterator pos, const_iterator first, const_iterator last)
+{
+	const uint at = pos - myData;
+
+	if (first >= myData && first < myData + mySize)
+	{
+		const Genes copy(first, last);
+		return insert(myData + at, copy.begin(), copy.end());
+	}
+
+	const uint n = last - first;
+	grow(mySize + n);
+	std::copy_backward(myData + at, myData + mySize, myData + mySize + n);
+	std::copy(first, last, myData + at);
+	mySize += n;
+
+	return myData + at;
+}
+
+Genes::iterator
+Genes::erase(const_iterator pos)
+{
+	return erase(pos, pos + 1);
+}
+
+Genes::iterator
+Genes::erase(const_iterator first, const_iterator last)
+{
+	iterator dst = myData + (first - myData);
+	std::copy(last, (const_iterator) end(), dst);
+	mySize -= last - first;
+
+	return dst;
+}
+
+void
+Genes::swap(Genes & rhs)
+{
+	if (bound() == rhs.bound())
+	{
+		std::swap(myData, rhs.myData);
+		std::swap(mySize, rhs.mySize);
+		std::swap(myCapacity, rhs.myCapacity);
+		std::swap(myOwned, rhs.myOwned);
+	}
+	else
+	{
+		Genes tmp(std::move(*this));
+		*this = std::move(rhs);
+		rhs = std::move(tmp);
+	}
+}
+
+void
+Genes::grow(const uint n)
+{
+	if (n <= myCapacity)
+		return;
+
+	const uint capacity = std::max(n, 2 * myCapacity);
+	Gene * genes = static_cast<Gene *>(::operator new(capacity * sizeof(Gene)));
+	std::uninitialized_copy(begin(), end(), genes);
+	if (myOwned)
+		::operator delete(myData);
+
+	myData = genes;
+	myCapacity = capacity;
+	myOwned = true;
+}
+
+void
+Genes::outOfRange(const uint i) const
+{
+	die("Genes::at(): gene %u of %u\n", i, mySize);
+	abort();
+}
+
+// GeneSlab
+
+GeneSlab::~GeneSlab()
+{
+	::operator delete(myGenes);
+}
+
+void
+GeneSlab::reset(const ulong slots, const uint slotLen)
+{
+	::operator delete(myGenes);
+	myGenes = static_cast<Gene *>(::operator new(slots * slotLen * sizeof(Gene)));
+	mySlots = slots;
+	mySlotLen = slotLen;
+}
+
+Gene *
+GeneSlab::slot(const ulong i) const
+{
+	panic_if(i >= mySlots, "GeneSlab::slot(): slot %lu of %lu\n", i, mySlots);
+	return myGenes + i * mySlotLen;
+}
+
+uint
+GeneSlab::slotLen() const
+{
+	return mySlotLen;
+}
+
 std::string
 genesToString(const Genes & genes)
 {
@@ -95,4 +321,111 @@ genesToString(const Genes & genes)
 	return ss.str();
 }
 
+int _testGenes()
+{
+	using namespace elfin;
+
+	msg("Testing Genes\n");
+
+	uint failCount = 0;
+
+	auto ids = [](const Genes & genes) {
+		std::vector<uint> out;
+		for (const auto & g : genes)
+			out.push_back(g.nodeId());
+		return out;
+	};
+
+	auto expect = [&failCount, &ids](const Genes & genes,
+	                                 const std::vector<uint> & expected,
+	                                 const char * what) {
+		if (ids(genes) != expected)
+		{
+			failCount++;
+			err("%s: got %lu genes, expected %lu\n",
+			    what, ids(genes).size(), expected.size());
+		}
+	};
+
+	GeneSlab slab;
+	slab.reset(2, 4);
+
+	// Edits in a slot stay in it
+	Genes bound;
+	bound.emplace_back(1);
+	bound.push_back(Gene(2));
+	bound.bind(slab.slot(0), slab.slotLen());
+	bound.insert(bound.begin() + 1, Gene(3));
+	bound.insert(bound.end(), bound.begin(), bound.begin() + 1);
+	expect(bound, {1, 3, 2, 1}, "insert() into a slot");
+
+	bound.erase(bound.begin() + 1, bound.begin() + 3);
+	expect(bound, {1, 1}, "erase() from a slot");
+
+	if (!bound.bound() || bound.data() != slab.slot(0))
+	{
+		failCount++;
+		err("Edits moved genes out of their slot\n");
+	}
+
+	// Copies and moves into a slot copy genes; out of one
+	// they leave it alone
+	Genes owned;
+	for (uint i = 0; i < 3; i++)
+		owned.emplace_back(10 + i);
+
+	bound = owned;
+	expect(bound, {10, 11, 12}, "Copy into a slot");
+
+	bound = Genes(owned);
+	const Genes moved(std::move(bound));
+	expect(bound, {10, 11, 12}, "Move out of a slot");
+	expect(moved, {10, 11, 12}, "Move from a slot");
+
+	if (!bound.bound() || bound.data() != slab.slot(0) || moved.bound())
+	{
+		failCount++;
+		err("Copies or moves took a slot with them\n");
+	}
+
+	// Swaps between slots exchange them; with an owned chain
+	// they exchange genes
+	Genes other;
+	other.emplace_back(20);
+	other.bind(slab.slot(1), slab.slotLen());
+	bound.swap(other);
+	expect(bound, {20}, "Swap between slots");
+	expect(other, {10, 11, 12}, "Swap between slots");
+
+	bound.swap(owned);
+	expect(bound, {10, 11, 12}, "Swap with an owned chain");
+	expect(owned, {20}, "Swap with an owned chain");
+
+	if (!bound.bound() || owned.bound())
+	{
+		failCount++;
+		err("Swap with an owned chain moved a slot\n");
+	}
+
+	// Outgrowing a slot moves to the heap
+	const Gene * slot = bound.data();
+	for (uint i = 0; i < 3; i++)
+		bound.emplace_back(30 + i);
+	expect(bound, {10, 11, 12, 30, 31, 32}, "Growth past a slot");
+
+	if (bound.bound() || slot[0].nodeId() != 10)
+	{
+		failCount++;
+		err("Growth past a slot left it bound or changed it\n");
+	}
+
+	// Test verdict
+	if (failCount == 0)
+		msg("Passed!\n");
+	else
+		err("Failed! failCount=%d\n", failCount);
+
+	return failCount;
+}
+
 } // namespace elfin
\ No newline at end of file
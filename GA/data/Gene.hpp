@@ -1,6 +1,8 @@
 #ifndef _GENE_HPP_
 #define _GENE_HPP_
 
+#include <new>
+#include <utility>
 #include <vector>
 
 #include "TypeDefs.hpp"
@@ -37,12 +39,132 @@ private:
 	Point3f myCom;
 };
 
-typedef std::vector<Gene> Genes;
-typedef std::vector<Gene>::const_iterator ConstGeneIterator;
+/*
+ * A chain of genes, with the part of the std::vector interface
+ * the solver uses. Storage is either owned and grown on the
+ * heap, or a fixed slot of a GeneSlab lent by bind(). A bound
+ * chain keeps its slot through copies and assignments, which
+ * copy genes into it, so chains that live in a slab never
+ * allocate; one that outgrows its slot moves to the heap.
+ */
+class Genes
+{
+public:
+	typedef Gene value_type;
+	typedef Gene * iterator;
+	typedef const Gene * const_iterator;
+
+	Genes() {}
+	Genes(const Genes & rhs);
+	Genes(Genes && rhs);
+	Genes(const_iterator first, const_iterator last);
+	~Genes();
+
+	Genes & operator=(const Genes & rhs);
+	Genes & operator=(Genes && rhs);
+
+	// Use slotLen genes from slot from now on; the slot must
+	// outlive this chain or the next bind()
+	void bind(Gene * slot, const uint slotLen);
+	bool bound() const { return myData && !myOwned; }
+
+	uint size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	uint capacity() const { return myCapacity; }
+
+	Gene * data() { return myData; }
+	const Gene * data() const { return myData; }
+	iterator begin() { return myData; }
+	const_iterator begin() const { return myData; }
+	iterator end() { return myData + mySize; }
+	const_iterator end() const { return myData + mySize; }
+
+	Gene & operator[](const uint i) { return myData[i]; }
+	const Gene & operator[](const uint i) const { return myData[i]; }
+	Gene & at(const uint i)
+	{
+		if (i >= mySize)
+			outOfRange(i);
+		return myData[i];
+	}
+	const Gene & at(const uint i) const
+	{
+		if (i >= mySize)
+			outOfRange(i);
+		return myData[i];
+	}
+	Gene & front() { return myData[0]; }
+	const Gene & front() const { return myData[0]; }
+	Gene & back() { return myData[mySize - 1]; }
+	const Gene & back() const { return myData[mySize - 1]; }
+
+	void reserve(const uint n);
+	void assign(const_iterator first, const_iterator last);
+	void clear() { mySize = 0; }
+	void push_back(const Gene & gene);
+	template <typename... Args>
+	void emplace_back(Args && ... args)
+	{
+		if (mySize == myCapacity)
+			grow(mySize + 1);
+		new (myData + mySize) Gene(std::forward<Args>(args)...);
+		mySize++;
+	}
+	void pop_back() { mySize--; }
+	iterator insert(const_iterator pos, const Gene & gene);
+	iterator insert(const_iterator pos, const_iterator first, const_iterator last);
+	iterator erase(const_iterator pos);
+	iterator erase(const_iterator first, const_iterator last);
+
+	// Exchanges storage when both chains are bound or both are
+	// not; otherwise genes are copied so that slots stay put
+	void swap(Genes & rhs);
+
+private:
+	// Capacity for at least n genes, moving to the heap if
+	// need be
+	void grow(const uint n);
+	// Kept out of line so that at() stays small
+	[[noreturn]] void outOfRange(const uint i) const;
+
+	Gene * myData = NULL;
+	uint mySize = 0;
+	uint myCapacity = 0;
+	bool myOwned = false; // Heap storage to be freed
+};
+
+typedef Genes::const_iterator ConstGeneIterator;
+
+/*
+ * One block of fixed-length gene slots, e.g. one per member of
+ * a population, so that chains bound to them sit next to each
+ * other in memory.
+ */
+class GeneSlab
+{
+public:
+	GeneSlab() {}
+	GeneSlab(const GeneSlab &) = delete;
+	GeneSlab & operator=(const GeneSlab &) = delete;
+	~GeneSlab();
+
+	// Replaces any previous slots, so chains bound to them must
+	// be rebound first
+	void reset(const ulong slots, const uint slotLen);
+	Gene * slot(const ulong i) const;
+	uint slotLen() const;
+
+private:
+	Gene * myGenes = NULL;
+	ulong mySlots = 0;
+	uint mySlotLen = 0;
+};
 
 std::string
 genesToString(const Genes & genes);
 
+int _testGenes();
+
 } // namespace elfin
 
 #endif /* include guard */
\ No newline at end of file
@@ -9,10 +9,6 @@
 namespace elfin
 {
 
-Vector3f::Vector3f(const Vector3f & rhs) :
-	x(rhs.x), y(rhs.y), z(rhs.z)
-{}
-
 Vector3f::Vector3f() :
 	x(0), y(0), z(0)
 {}
@@ -254,4 +250,84 @@ Mat3x3::transpose() const
 	return Mat3x3(v);
 }
 
+RigidTransform::RigidTransform()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			myRot[i][j] = i == j ? 1.0 : 0.0;
+		myTran[i] = 0.0;
+	}
+}
+
+RigidTransform::RigidTransform(const Mat3x3 & rot, const Vector3f & tran)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		const float * row = &rot.rows[i].x;
+		for (int j = 0; j < 3; j++)
+			myRot[i][j] = row[j];
+	}
+
+	myTran[0] = tran.x;
+	myTran[1] = tran.y;
+	myTran[2] = tran.z;
+}
+
+RigidTransform
+RigidTransform::inverse(const Mat3x3 & rotInv, const Vector3f & tran)
+{
+	RigidTransform rt(rotInv, Vector3f(0, 0, 0));
+
+	// (x - tran).dot(rotInv) = x.dot(rotInv) - tran.dot(rotInv)
+	const double t[3] = { tran.x, tran.y, tran.z };
+	for (int j = 0; j < 3; j++)
+		rt.myTran[j] = -(t[0] * rt.myRot[0][j] +
+		                 t[1] * rt.myRot[1][j] +
+		                 t[2] * rt.myRot[2][j]);
+
+	return rt;
+}
+
+RigidTransform
+RigidTransform::then(const RigidTransform & rhs) const
+{
+	RigidTransform out;
+
+	// (x.dot(A) + a).dot(B) + b = x.dot(AB) + (a.dot(B) + b)
+	for (int j = 0; j < 3; j++)
+	{
+		for (int i = 0; i < 3; i++)
+			out.myRot[i][j] = myRot[i][0] * rhs.myRot[0][j] +
+			                  myRot[i][1] * rhs.myRot[1][j] +
+			                  myRot[i][2] * rhs.myRot[2][j];
+
+		out.myTran[j] = myTran[0] * rhs.myRot[0][j] +
+		                myTran[1] * rhs.myRot[1][j] +
+		                myTran[2] * rhs.myRot[2][j] +
+		                rhs.myTran[j];
+	}
+
+	return out;
+}
+
+Vector3f
+RigidTransform::apply(const Vector3f & v) const
+{
+	double out[3];
+	for (int j = 0; j < 3; j++)
+		out[j] = v.x * myRot[0][j] +
+		         v.y * myRot[1][j] +
+		         v.z * myRot[2][j] +
+		         myTran[j];
+
+	return Vector3f(out[0], out[1], out[2]);
+}
+
+Vector3f
+RigidTransform::origin() const
+{
+	return Vector3f(myTran[0], myTran[1], myTran[2]);
+}
+
 } // namespace elfin
\ No newline at end of file
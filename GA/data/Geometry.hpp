@@ -15,7 +15,9 @@ class Vector3f
 public:
 	float x, y, z;
 
-	Vector3f(const Vector3f & rhs);
+	// Trivial, so that arrays of points and genes copy as
+	// plain memory
+	Vector3f(const Vector3f & rhs) = default;
 
 	Vector3f();
 
@@ -66,6 +68,35 @@ public:
 	std::string toString() const;
 };
 
+/*
+ * Row-vector rigid transform x -> x.dot(rot) + tran, in
+ * double so that chains of them can be composed without
+ * float drift.
+ */
+class RigidTransform
+{
+public:
+	RigidTransform(); // Identity
+
+	RigidTransform(const Mat3x3 & rot, const Vector3f & tran);
+
+	// x -> (x - tran).dot(rotInv), the undoing of
+	// RigidTransform(rot, tran) when rotInv is rot's inverse
+	static RigidTransform inverse(const Mat3x3 & rotInv,
+	                              const Vector3f & tran);
+
+	// x -> rhs.apply(apply(x))
+	RigidTransform then(const RigidTransform & rhs) const;
+
+	Vector3f apply(const Vector3f & v) const;
+
+	// Translation part, i.e. where the origin goes
+	Vector3f origin() const;
+
+private:
+	double myRot[3][3];
+	double myTran[3];
+};
 
 } // namespace elfin
 
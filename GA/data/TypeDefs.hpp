@@ -25,7 +25,6 @@ typedef std::map<long, std::string> IdNameMap;
 typedef std::vector<PairRelationship *> RelaRow;
 typedef std::vector<RelaRow> RelaMat;
 
-typedef std::vector<long> IdRoulette;
 typedef std::vector<long> Ids;
 
 
@@ -54,6 +53,46 @@ struct Radii
 };
 typedef std::vector<Radii> RadiiList;
 
+// Which Radii field decides whether two genes collide
+#define FOREACH_COLLISION_MEASURE(v) \
+		v(AvgAll) \
+		v(MaxCA) \
+		v(MaxHeavy)
+
+GEN_ENUM_AND_STRING(CollisionMeasure, CollisionMeasureString, FOREACH_COLLISION_MEASURE);
+
+// Methods that turn Kabsch statistics into a score
+#define FOREACH_SCORE_BACKEND(v) \
+		v(Rosetta) \
+		v(QCP)
+
+GEN_ENUM_AND_STRING(ScoreBackend, ScoreBackendString, FOREACH_SCORE_BACKEND);
+
+// Arithmetic used to accumulate Kabsch statistics; the
+// eigen-solve is always done in double
+#define FOREACH_SCORE_PRECISION(v) \
+		v(Double) \
+		v(Float) \
+		v(Kahan)
+
+GEN_ENUM_AND_STRING(ScorePrecision, ScorePrecisionString, FOREACH_SCORE_PRECISION);
+
+// What the GA minimises: one Kabsch fit of the whole shape,
+// or the sum of sliding window fits (see WindowedKabsch.hpp)
+#define FOREACH_SCORE_MODE(v) \
+		v(Global) \
+		v(Windowed)
+
+GEN_ENUM_AND_STRING(ScoreMode, ScoreModeString, FOREACH_SCORE_MODE);
+
+// Where islands send their best individuals: the next island
+// only, or every other island
+#define FOREACH_MIGRATE_TOPOLOGY(v) \
+		v(Ring) \
+		v(Full)
+
+GEN_ENUM_AND_STRING(MigrateTopology, MigrateTopologyString, FOREACH_MIGRATE_TOPOLOGY);
+
 struct OptionPack
 {
 	// Input settings
@@ -80,13 +119,36 @@ struct OptionPack
 	float gaPointMutateRate = 0.5f;
 	float gaLimbMutateRate = 0.5f;
 
+	// Sub-populations that rank and select on their own; 1
+	// evolves one panmictic population
+	uint gaIslands = 1;
+	uint gaMigrateInterval = 10; // Generations between migrations
+	uint gaMigrateCount = 4; // Individuals each island sends
+	MigrateTopology gaMigrateTopology = Ring;
+	// Individuals keep only node IDs, trading placement work
+	// for memory
+	bool compactPopulation = false;
+
 	// Use a small number but not exactly 0.0
 	// because of imprecise float comparison
 	float scoreStopThreshold = 0.01f;
 
 	int maxStagnantGens = 50;
 
+	ScoreBackend scoreBackend = Rosetta;
+	ScorePrecision scorePrecision = Double;
+	bool incrementalScoring = false;
+	bool lowerBoundFilter = true;
+	CollisionMeasure collisionMeasure = MaxHeavy;
+
+	// Windowed scores are written out alongside solutions
+	// when windowLen is non-zero
+	ScoreMode scoreMode = Global;
+	uint windowLen = 0;
+	float windowOverlapRatio = 0.5f;
+
 	bool runUnitTests = false;
+	bool runBenchmarks = false;
 };
 
 } // namespace elfin
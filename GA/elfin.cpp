@@ -4,6 +4,7 @@
 #include <csignal>
 #include <iostream>
 #include <fstream>
+#include <strings.h>
 
 #include "data/TypeDefs.hpp"
 #include "util.h"
@@ -14,6 +15,14 @@
 #include "core/ParallelUtils.hpp"
 #include "core/MathUtils.hpp"
 #include "core/Kabsch.hpp"
+#include "core/ArcLengthIndex.hpp"
+#include "core/WindowedKabsch.hpp"
+#include "core/CollisionGrid.hpp"
+#include "core/ExclusionTable.hpp"
+#include "core/SegmentSpheres.hpp"
+#include "core/Roulette.hpp"
+#include "core/RadixSort.hpp"
+#include "data/ChainBatch.hpp"
 
 namespace elfin
 {
@@ -39,8 +48,109 @@ DECL_ARG_CALLBACK(setGaLimbMutateRate) { options.gaLimbMutateRate = parse_float(
 DECL_ARG_CALLBACK(setScoreStopThreshold) { options.scoreStopThreshold = parse_float(arg_in); }
 DECL_ARG_CALLBACK(setMaxStagnantGens) { options.maxStagnantGens = parse_long(arg_in); }
 
+DECL_ARG_CALLBACK(setScoreBackend)
+{
+    const size_t nBackends = sizeof(ScoreBackendString) / sizeof(ScoreBackendString[0]);
+    for (size_t i = 0; i < nBackends; i++)
+    {
+        if (strcasecmp(arg_in, ScoreBackendString[i]) == 0)
+        {
+            options.scoreBackend = (ScoreBackend) i;
+            return;
+        }
+    }
+
+    die("Unknown score backend: \"%s\"\n", arg_in);
+}
+
+DECL_ARG_CALLBACK(setScorePrecision)
+{
+    const size_t nPrecisions = sizeof(ScorePrecisionString) / sizeof(ScorePrecisionString[0]);
+    for (size_t i = 0; i < nPrecisions; i++)
+    {
+        if (strcasecmp(arg_in, ScorePrecisionString[i]) == 0)
+        {
+            options.scorePrecision = (ScorePrecision) i;
+            return;
+        }
+    }
+
+    die("Unknown score precision: \"%s\"\n", arg_in);
+}
+
+DECL_ARG_CALLBACK(setScoreMode)
+{
+    const size_t nModes = sizeof(ScoreModeString) / sizeof(ScoreModeString[0]);
+    for (size_t i = 0; i < nModes; i++)
+    {
+        if (strcasecmp(arg_in, ScoreModeString[i]) == 0)
+        {
+            options.scoreMode = (ScoreMode) i;
+            return;
+        }
+    }
+
+    die("Unknown score mode: \"%s\"\n", arg_in);
+}
+
+DECL_ARG_CALLBACK(setCollisionMeasure)
+{
+    const size_t nMeasures = sizeof(CollisionMeasureString) / sizeof(CollisionMeasureString[0]);
+    for (size_t i = 0; i < nMeasures; i++)
+    {
+        if (strcasecmp(arg_in, CollisionMeasureString[i]) == 0)
+        {
+            options.collisionMeasure = (CollisionMeasure) i;
+            return;
+        }
+    }
+
+    die("Unknown collision measure: \"%s\"\n", arg_in);
+}
+
+DECL_ARG_CALLBACK(setGaMigrateTopology)
+{
+    const size_t nTopologies = sizeof(MigrateTopologyString) / sizeof(MigrateTopologyString[0]);
+    for (size_t i = 0; i < nTopologies; i++)
+    {
+        if (strcasecmp(arg_in, MigrateTopologyString[i]) == 0)
+        {
+            options.gaMigrateTopology = (MigrateTopology) i;
+            return;
+        }
+    }
+
+    die("Unknown migration topology: \"%s\"\n", arg_in);
+}
+
+DECL_ARG_CALLBACK(setGaIslands) { options.gaIslands = parse_long(arg_in); }
+DECL_ARG_CALLBACK(setGaMigrateInterval) { options.gaMigrateInterval = parse_long(arg_in); }
+DECL_ARG_CALLBACK(setGaMigrateCount) { options.gaMigrateCount = parse_long(arg_in); }
+
+DECL_ARG_CALLBACK(setWindowLen) { options.windowLen = parse_long(arg_in); }
+DECL_ARG_CALLBACK(setWindowOverlapRatio) { options.windowOverlapRatio = parse_float(arg_in); }
+
+DECL_ARG_CALLBACK(setIncrementalScoring)
+{
+    options.incrementalScoring =
+        strcasecmp(arg_in, "true") == 0 || strcmp(arg_in, "1") == 0;
+}
+
+DECL_ARG_CALLBACK(setLowerBoundFilter)
+{
+    options.lowerBoundFilter =
+        strcasecmp(arg_in, "true") == 0 || strcmp(arg_in, "1") == 0;
+}
+
+DECL_ARG_CALLBACK(setCompactPopulation)
+{
+    options.compactPopulation =
+        strcasecmp(arg_in, "true") == 0 || strcmp(arg_in, "1") == 0;
+}
+
 DECL_ARG_CALLBACK(setLogLevel) { set_log_level((Log_Level) parse_long(arg_in)); }
 DECL_ARG_CALLBACK(setRunUnitTests) { options.runUnitTests = true; }
+DECL_ARG_CALLBACK(setRunBenchmarks) { options.runBenchmarks = true; }
 
 const argument_bundle argb[] = {
     {"-h", "--help", "Print this help text and exit", false, helpAndExit},
@@ -57,10 +167,24 @@ const argument_bundle argb[] = {
     {"-gcr", "--gaCrossRate", "Set GA surviver cross rate (default 0.60)", true, setGaCrossRate},
     {"-gmr", "--gaPointMutateRate", "Set GA surviver point mutation rate (default 0.3)", true, setGaPointMutateRate},
     {"-gmr", "--gaLimbMutateRate", "Set GA surviver limb mutation rate (default 0.3)", true, setGaLimbMutateRate},
+    {"-gis", "--gaIslands", "Set number of GA islands that rank and select separately (default 1)", true, setGaIslands},
+    {"-gmi", "--gaMigrateInterval", "Set generations between island migrations (default 10)", true, setGaMigrateInterval},
+    {"-gmc", "--gaMigrateCount", "Set individuals each island sends per migration (default 4)", true, setGaMigrateCount},
+    {"-gmt", "--gaMigrateTopology", "Set where islands send migrants: Ring or Full (default Ring)", true, setGaMigrateTopology},
+    {"-cp", "--compactPopulation", "Keep only node IDs of individuals, placing genes when scored or mutated: true or false (default false)", true, setCompactPopulation},
     {"-stt", "--scoreStopThreshold", "Set GA exit score threshold (default 0.0)", true, setScoreStopThreshold},
     {"-msg", "--maxStagnantGens", "Set number of stagnant generations before GA exits (default 50)", true, setMaxStagnantGens},
+    {"-sb", "--scoreBackend", "Set scoring backend: Rosetta or QCP (default Rosetta)", true, setScoreBackend},
+    {"-is", "--incrementalScoring", "Score chromosomes while synthesising them: true or false (default false)", true, setIncrementalScoring},
+    {"-sp", "--scorePrecision", "Set Kabsch accumulation precision: Double, Float or Kahan (default Double)", true, setScorePrecision},
+    {"-sm", "--scoreMode", "Set GA fitness: Global or Windowed (default Global)", true, setScoreMode},
+    {"-wl", "--windowLen", "Set windowed scoring window length in points; also outputs windowed scores (default 0 = off)", true, setWindowLen},
+    {"-wor", "--windowOverlapRatio", "Set overlap ratio of consecutive windows (default 0.5)", true, setWindowOverlapRatio},
+    {"-lbf", "--lowerBoundFilter", "Skip full scoring of offspring bounded out of the survivor set: true or false (default true)", true, setLowerBoundFilter},
+    {"-cm", "--collisionMeasure", "Set module radius used for collision checks: AvgAll, MaxCA or MaxHeavy (default MaxHeavy)", true, setCollisionMeasure},
     {"-lg", "--logLevel", "Set log level", true, setLogLevel},
-    {"-t", "--test", "Run unit tests", false, setRunUnitTests}
+    {"-t", "--test", "Run unit tests", false, setRunUnitTests},
+    {"-b", "--bench", "Run microbenchmarks", false, setRunBenchmarks}
 };
 const size_t ARG_BUND_SIZE = (sizeof(argb) / sizeof(argb[0]));
 
@@ -143,6 +267,21 @@ void parseSettings()
     if (!j["gaLimbMutateRate"].is_null())
         setGaLimbMutateRate(jsonToCStr(j["gaLimbMutateRate"]));
 
+    if (!j["gaIslands"].is_null())
+        setGaIslands(jsonToCStr(j["gaIslands"]));
+
+    if (!j["gaMigrateInterval"].is_null())
+        setGaMigrateInterval(jsonToCStr(j["gaMigrateInterval"]));
+
+    if (!j["gaMigrateCount"].is_null())
+        setGaMigrateCount(jsonToCStr(j["gaMigrateCount"]));
+
+    if (!j["gaMigrateTopology"].is_null())
+        setGaMigrateTopology(jsonToCStr(j["gaMigrateTopology"]));
+
+    if (!j["compactPopulation"].is_null())
+        setCompactPopulation(jsonToCStr(j["compactPopulation"]));
+
     if (!j["scoreStopThreshold"].is_null())
         setScoreStopThreshold(jsonToCStr(j["scoreStopThreshold"]));
 
@@ -152,6 +291,30 @@ void parseSettings()
     if (!j["avgPairDist"].is_null())
         setAvgPairDist(jsonToCStr(j["avgPairDist"]));
 
+    if (!j["scoreBackend"].is_null())
+        setScoreBackend(jsonToCStr(j["scoreBackend"]));
+
+    if (!j["incrementalScoring"].is_null())
+        setIncrementalScoring(jsonToCStr(j["incrementalScoring"]));
+
+    if (!j["scorePrecision"].is_null())
+        setScorePrecision(jsonToCStr(j["scorePrecision"]));
+
+    if (!j["scoreMode"].is_null())
+        setScoreMode(jsonToCStr(j["scoreMode"]));
+
+    if (!j["windowLen"].is_null())
+        setWindowLen(jsonToCStr(j["windowLen"]));
+
+    if (!j["windowOverlapRatio"].is_null())
+        setWindowOverlapRatio(jsonToCStr(j["windowOverlapRatio"]));
+
+    if (!j["lowerBoundFilter"].is_null())
+        setLowerBoundFilter(jsonToCStr(j["lowerBoundFilter"]));
+
+    if (!j["collisionMeasure"].is_null())
+        setCollisionMeasure(jsonToCStr(j["collisionMeasure"]));
+
 }
 
 void checkOptions()
@@ -209,6 +372,12 @@ void checkOptions()
 
     panic_if(options.gaIters < 0, "Number of iterations cannot be < 0\n");
 
+    panic_if(options.gaIslands < 1 || options.gaIslands > options.gaPopSize,
+             "Number of islands must be between 1 and the population size\n");
+
+    panic_if(options.gaMigrateInterval < 1,
+             "Migration interval must be at least 1 generation\n");
+
     panic_if(options.chromoLenDev < 0,
              "Gene length deviation must be an integer > 0\n");
 
@@ -251,6 +420,14 @@ void checkOptions()
 
     panic_if(options.avgPairDist < 0, "Average CoM distance must be > 0\n");
 
+    // Scoring
+    panic_if(options.windowOverlapRatio < 0.0 ||
+             options.windowOverlapRatio >= 1.0,
+             "Window overlap ratio must be between 0 inclusive and 1 exclusive\n");
+
+    if (options.scoreMode == Windowed && options.windowLen == 0)
+        wrn("Windowed score mode with window length 0 is the same as global scoring\n");
+
 }
 
 Points3f parseInput()
@@ -332,7 +509,32 @@ int runUnitTests()
     int failCount = 0;
     failCount += _testMathUtils();
     failCount += _testKabsch();
+    failCount += _testArcLengthIndex();
+    failCount += _testWindowedKabsch();
+    failCount += _testRoulette();
+    failCount += _testRadixSort();
+    failCount += _testGenes();
+    failCount += _testCollisionGrid();
+    failCount += _testExclusionTable();
+    failCount += _testSegmentSpheres();
     failCount += _testChromosome();
+    failCount += _testChainBatch();
+    return failCount;
+}
+
+int runBenchmarks()
+{
+    msg("Running benchmarks...\n");
+    int failCount = 0;
+    failCount += _benchKabsch();
+    failCount += _benchArcLengthIndex();
+    failCount += _benchCollisionGrid();
+    failCount += _benchCollisionKernel();
+    failCount += _benchPointMutate();
+    failCount += _benchChainBatch();
+    failCount += _benchSynthesiseSplice();
+    failCount += _benchRadixSort();
+    failCount += _benchGeneSlab();
     return failCount;
 }
 
@@ -484,6 +686,11 @@ int main(int argc, const char ** argv)
             msg("Passed!\n");
         }
     }
+    else if (options.runBenchmarks)
+    {
+        if (runBenchmarks() > 0)
+            die("Some benchmarks failed\n");
+    }
     else
     {
         es = new EvolutionSolver(relaMat,
@@ -506,6 +713,26 @@ int main(int argc, const char ** argv)
             j["nodes"] = nn;
             j["score"] = p->at(i).getScore();
 
+            if (options.windowLen > 0)
+            {
+                const WindowStats ws = windowedKabsch(
+                                           p->at(i).genes(),
+                                           es->specContext(),
+                                           options.windowLen,
+                                           windowStep(options.windowLen, options.windowOverlapRatio),
+                                           options.scoreBackend);
+                j["windowed"] = {
+                    {"windowLen", options.windowLen},
+                    {"windows", ws.count},
+                    {"sum", ws.sum},
+                    {"avg", ws.avgRmsd},
+                    {"min", ws.minRmsd},
+                    {"max", ws.maxRmsd}
+                };
+                msg("Solution #%d windowed RMSD avg %.2f min %.2f max %.2f over %u windows\n",
+                    i, ws.avgRmsd, ws.minRmsd, ws.maxRmsd, ws.count);
+            }
+
             std::ostringstream ss;
             ss << options.outputDir << "/" << &p->at(i) << ".json";
             std::string dump = j.dump();